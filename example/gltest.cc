@@ -19,9 +19,11 @@ class GraphicContext : public v8_webgl::GraphicContext {
     gl_widget_->resize(width, height);
   }
   void MakeCurrent() {
-    //XXX optimize this
     gl_widget_->makeCurrent();
   }
+  void ReleaseCurrent() {
+    gl_widget_->doneCurrent();
+  }
  private:
   QGLWidget* gl_widget_;
 };
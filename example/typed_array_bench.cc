@@ -0,0 +1,98 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Typed array allocation benchmark, needs no GL context.
+// Build with qmake CONFIG+=typed_array_bench.
+
+#include <v8.h>
+#include <v8_webgl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+
+class GraphicContext : public v8_webgl::GraphicContext {
+ public:
+  void Resize(int, int) {}
+  void MakeCurrent() {}
+};
+
+class Factory : public v8_webgl::Factory, v8_webgl::Logger {
+ public:
+  void Log(Level level, std::string& msg) {
+    std::cerr << msg << std::endl;
+  }
+  v8_webgl::GraphicContext* CreateGraphicContext(int, int) {
+    return new GraphicContext();
+  }
+  Logger* GetLogger() { return this; }
+};
+
+static double MonotonicTimeMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Runs source after a full GC and prints the time per iteration.
+static void Run(const char* name, const char* source, int iterations) {
+  v8::HandleScope handle_scope;
+  v8::Handle<v8::Script> script = v8::Script::Compile(v8::String::New(source));
+  v8::Script::Compile(v8::String::New("gc();"))->Run();
+
+  double start = MonotonicTimeMs();
+  script->Run();
+  double elapsed = MonotonicTimeMs() - start;
+
+  printf("%-32s %10.1f ms %10.1f ns/iteration %12.0f/s\n", name, elapsed,
+         elapsed * 1e6 / iterations, iterations / elapsed * 1e3);
+}
+
+// Matrix churn of a render loop, each frame allocates and drops
+// 1000 Float32Array(16). Includes the GC cost of dropping them.
+static const int kFrames = 1000;
+static const int kArraysPerFrame = 1000;
+static const char* kChurnSource =
+"for (var frame = 0; frame < 1000; frame++) {"
+"  for (var i = 0; i < 1000; i++) {"
+"    var m = new Float32Array(16);"
+"    m[0] = i;"
+"  }"
+"}";
+
+// Construction rate, arrays are kept alive in a window of 10000 so the
+// run mostly measures the constructor rather than collection. Typed array
+// accessors are set up through the instance template, not per instance.
+static const int kCreations = 1000000;
+static const char* kCreate4Source =
+"var window = new Array(10000);"
+"for (var i = 0; i < 1000000; i++)"
+"  window[i % 10000] = new Float32Array(4);";
+static const char* kCreate16Source =
+"var window = new Array(10000);"
+"for (var i = 0; i < 1000000; i++)"
+"  window[i % 10000] = new Float32Array(16);";
+
+int main(int argc, char* argv[])
+{
+  {
+    v8::HandleScope handle_scope;
+
+    const char* kExposeGC = "--expose-gc";
+    v8::V8::SetFlagsFromString(kExposeGC, strlen(kExposeGC));
+
+    v8::Handle<v8::ObjectTemplate> global = v8_webgl::Initialize(new Factory());
+    v8::Persistent<v8::Context> context = v8::Context::New(NULL, global);
+    {
+      v8::Context::Scope context_scope(context);
+      Run("Float32Array(16) churn", kChurnSource, kFrames * kArraysPerFrame);
+      Run("Float32Array(4) creation", kCreate4Source, kCreations);
+      Run("Float32Array(16) creation", kCreate16Source, kCreations);
+    }
+    context.Dispose();
+  }
+
+  v8_webgl::Uninitialize();
+  return 0;
+}
@@ -7,9 +7,16 @@
 
 #include <v8.h>
 #include <string>
+#include <vector>
 
-//XXX caller needs to use v8::Locker to "do anything" in v8 from another thread - i.e. if we use one isolate, then all access from multiple threads must be locked
-//XXX also GL context can be used from only one thread at a time - may need to expose thread switching API so we can optimize making GL context current? (e.g. can't stash current context, need to link it to it's thread)
+// Threading: an isolate used from several threads must be locked with
+// v8::Locker, and a GL context can only be current on one thread at a
+// time. v8-webgl remembers the GL context it last made current per
+// isolate and skips redundant switches, so threads must hand an isolate
+// over with ContextLock (or call ReleaseCurrentContext before unlocking).
+// Isolates initialized separately need no locking between each other,
+// except that shader translation is serialized across the process
+// internally, the ANGLE translator is not thread safe.
 
 namespace v8_webgl {
 
@@ -19,6 +26,9 @@ class GraphicContext {
   virtual ~GraphicContext() {}
   virtual void Resize(int width, int height) = 0;
   virtual void MakeCurrent() = 0;
+  // Make no context current on the calling thread, so another thread can
+  // make this one current. Needed if contexts move between threads.
+  virtual void ReleaseCurrent() {}
 };
 
 //////
@@ -36,20 +46,307 @@ class Factory {
  public:
   virtual ~Factory() {}
   virtual GraphicContext* CreateGraphicContext(int width, int height) = 0;
+  // Return true if CreateSharedGraphicContext is implemented. Scripts can
+  // then pass the shareGroup context attribute, contexts with the same
+  // shareGroup share their buffers and textures.
+  virtual bool CanShareGraphicContexts() { return false; }
+  // Create a context sharing GL objects with share_context, as with a
+  // share list. Commands are flushed when switching away from a shared
+  // context, so embedders making their own contexts current in between
+  // should glFlush shared contexts themselves.
+  virtual GraphicContext* CreateSharedGraphicContext(int width, int height, GraphicContext* /*share_context*/) {
+    return CreateGraphicContext(width, height);
+  }
   // Logger instance, return 0 to disable logging via console.
   // Logger instance should live for as long as Factory.
   virtual Logger* GetLogger() { return 0; }
+  // Return true to let scripts request the trustedShaders context attribute,
+  // which compiles shaders without the WebGL loop and indexing restrictions.
+  // Only enable this if all scripts are trusted.
+  virtual bool AllowTrustedShaders() { return false; }
+  // Return true to have compileShader wait for the driver to finish, so
+  // ShaderStats report driver compile times. This serializes compiles.
+  virtual bool MeasureShaderCompileTime() { return false; }
+  // Return true to let scripts map path with ArrayBuffer.mapFile().
+  // Files are always mapped copy-on-write, script writes stay private to
+  // the buffer and are never written to the file. read_only is what the
+  // script asked for and only informs this decision.
+  virtual bool CanMapFile(const std::string& /*path*/, bool /*read_only*/) { return false; }
   //XXX image method - pass in string name - don't want to return data though, want to upload to gpu (and need to know size, format etc.)
 };
 
 //////
 
-// Initialize v8-webgl and return the global object template.
-// This will be valid until uninitialize().
+// Initialize v8-webgl for the current isolate and return the global
+// object template. This will be valid until Uninitialize().
 // Factory will be destroyed when Unintialized.
+// Each isolate has its own state and Factory, so isolates initialized
+// separately can run on different threads at the same time.
 v8::Persistent<v8::ObjectTemplate> Initialize(Factory* factory);
 
-void Uninitialize();
+// Uninitialize v8-webgl for the current isolate. Pass dispose_v8 false
+// if other isolates still use v8. ArrayBuffer storage cached for reuse
+// is only released for the calling thread, other threads release theirs
+// when they exit.
+void Uninitialize(bool dispose_v8 = true);
+
+// Locks isolate for the calling thread like v8::Locker. On unlocking,
+// the GL context v8-webgl made current is released from the thread, so
+// whichever thread locks the isolate next can use its contexts.
+class ContextLock {
+ public:
+  explicit ContextLock(v8::Isolate* isolate);
+  ~ContextLock();
+
+ private:
+  ContextLock(const ContextLock&);
+  ContextLock& operator = (const ContextLock&);
+
+  v8::Isolate* isolate_;
+  v8::Locker locker_;
+};
+
+// Release the GL context v8-webgl made current on the calling thread for
+// the current isolate. Call before making other GL contexts current, or
+// before another thread uses the isolate without ContextLock.
+void ReleaseCurrentContext();
+
+// Create count graphic contexts for the current isolate ahead of time, so
+// getContext leases an idle one instead of creating it. Contexts of
+// disposed WebGLRenderingContexts are reset and kept idle for reuse,
+// up to count in total. Call after Initialize, e.g. at startup.
+void PrewarmGraphicContexts(int count, int width, int height);
+
+//////
+
+struct ProgramSource {
+  std::string vertex_source;
+  std::string fragment_source;
+  // Attribute names, bound to locations 0..n-1 before linking.
+  std::vector<std::string> attributes;
+};
+
+// All times are in milliseconds.
+struct ProgramTimings {
+  ProgramTimings()
+      : linked(false)
+      , translate_time(0)
+      , compile_time(0)
+      , link_time(0)
+      , warmup_time(0) {}
+  // The WebGLProgram, valid while the caller's HandleScope is alive.
+  v8::Handle<v8::Object> program;
+  bool linked;
+  double translate_time;
+  double compile_time;
+  double link_time;
+  double warmup_time;
+};
+
+// Translate, compile and link a set of programs on a WebGLRenderingContext,
+// then draw once with each so the driver finishes any compilation it defers
+// until first use. Call at load time to keep that work out of the first frame.
+// Returns false if context is not a WebGLRenderingContext.
+bool PrecompilePrograms(v8::Handle<v8::Object> context,
+                        const std::vector<ProgramSource>& sources,
+                        std::vector<ProgramTimings>* timings);
+
+// Objects released with dispose() are deleted from GL the next time their
+// WebGLRenderingContext is used. Call at frame end to delete them now,
+// this makes the context current.
+// Returns false if context is not a WebGLRenderingContext.
+bool FlushDeleteQueue(v8::Handle<v8::Object> context);
+
+//////
+
+// Log2 histogram of times in milliseconds. Bucket 0 counts times under 1ms,
+// bucket i counts [2^(i-1), 2^i) ms and the last bucket is open ended.
+struct TimeHistogram {
+  enum { kBuckets = 16 };
+  TimeHistogram() : count(0), total(0), max(0) {
+    for (int i = 0; i < kBuckets; i++)
+      buckets[i] = 0;
+  }
+  void Add(double time) {
+    int bucket = 0;
+    while (bucket < kBuckets - 1 && time >= (1 << bucket))
+      bucket++;
+    buckets[bucket]++;
+    count++;
+    total += time;
+    if (time > max)
+      max = time;
+  }
+  unsigned int count;
+  double total;
+  double max;
+  unsigned int buckets[kBuckets];
+};
+
+struct ShaderCompileRecord {
+  ShaderCompileRecord()
+      : shader_type(0)
+      , source_size(0)
+      , translated_size(0)
+      , translate_time(0)
+      , compile_time(0)
+      , valid(false) {}
+  unsigned int shader_type;
+  size_t source_size;
+  size_t translated_size;
+  double translate_time;
+  // Driver compile time if Factory::MeasureShaderCompileTime(), otherwise
+  // only the time to submit the compile. The rest of the driver work, and
+  // that of programs compiled by PrecompilePrograms, may show up as link
+  // time instead.
+  double compile_time;
+  bool valid;
+};
+
+struct ProgramLinkRecord {
+  ProgramLinkRecord(double link_time = 0, bool linked = false)
+      : link_time(link_time)
+      , linked(linked) {}
+  double link_time;
+  bool linked;
+};
+
+// Shader pipeline statistics for a WebGLRenderingContext.
+// Histograms cover the context lifetime, record lists keep the most recent.
+struct ShaderStats {
+  enum { kMaxRecords = 256 };
+  std::vector<ShaderCompileRecord> shaders;
+  std::vector<ProgramLinkRecord> programs;
+  TimeHistogram translate_times;
+  TimeHistogram compile_times;
+  TimeHistogram link_times;
+};
+
+// Returns false if context is not a WebGLRenderingContext.
+bool GetShaderStats(v8::Handle<v8::Object> context, ShaderStats* stats);
+
+// GPU memory held by a WebGLRenderingContext's objects, in bytes.
+// Estimated from the sizes and formats passed to bufferData, copyTexImage2D
+// and renderbufferStorage, drivers may allocate more.
+// The same amounts are reported to v8 as external memory.
+struct MemoryInfo {
+  MemoryInfo()
+      : buffer_bytes(0)
+      , texture_bytes(0)
+      , renderbuffer_bytes(0) {}
+  size_t total_bytes() const { return buffer_bytes + texture_bytes + renderbuffer_bytes; }
+  size_t buffer_bytes;
+  size_t texture_bytes;
+  size_t renderbuffer_bytes;
+};
+
+// Returns false if context is not a WebGLRenderingContext.
+bool GetMemoryInfo(v8::Handle<v8::Object> context, MemoryInfo* info);
+
+//////
+
+// Runs effect functions one after another on a single
+// WebGLRenderingContext, without reading pixels back in between.
+// While an effect runs, bindFramebuffer(null) binds an offscreen
+// framebuffer with a color texture attachment instead of the drawing
+// buffer. Two of them are used in turn, the texture drawn by one
+// effect is the input of the next.
+class EffectChain {
+ public:
+  virtual ~EffectChain() {}
+  // effect is called as effect(gl, input), input being the WebGLTexture
+  // drawn by the previous effect, or null for the first effect.
+  virtual void AddEffect(v8::Handle<v8::Function> effect) = 0;
+  // Runs all effects in the current v8 context. Returns false if the
+  // rendering context is disposed or an effect threw, exceptions are
+  // left to the caller's TryCatch.
+  virtual bool Run() = 0;
+  // WebGLTexture drawn by the last effect, e.g. for compositing in the
+  // rendering context. Empty if the last Run failed or none ran yet.
+  virtual v8::Handle<v8::Object> GetOutput() = 0;
+  // Read the output as width x height RGBA pixels, bottom row first.
+  virtual bool ReadPixels(void* pixels) = 0;
+};
+
+// Create an EffectChain drawing width x height on context, delete it
+// before disposing context.
+// Returns NULL if context is not a WebGLRenderingContext.
+EffectChain* CreateEffectChain(v8::Handle<v8::Object> context, int width, int height);
+
+//////
+
+// Renders frames of one script in parallel. Each worker thread creates
+// its own isolate, Initializes v8-webgl on it with a Factory from
+// CreateFactory, and runs the script, which must define a global
+// renderFrame(frame) function. Frame numbers are handed out in order to
+// whichever worker is free, and results are delivered in frame order.
+// Shader compiles in renderFrame are serialized across workers, so
+// compile programs up front in the script rather than per frame.
+// Embedders subclass this and call Run.
+class FrameScheduler {
+ public:
+  virtual ~FrameScheduler() {}
+
+  // Called on each worker thread, the Factory is owned by its isolate.
+  virtual Factory* CreateFactory() = 0;
+  // Called on the worker thread after renderFrame(frame) returned result,
+  // in the worker's v8 context. Read back the frame here and return it.
+  virtual void* FinishFrame(int frame, v8::Handle<v8::Value> result) = 0;
+  // Called on the thread calling Run, in frame order.
+  virtual void DeliverFrame(int frame, void* data) = 0;
+  // Called on the thread calling Run for finished frames that are not
+  // delivered because an earlier frame failed.
+  virtual void DiscardFrame(int /*frame*/, void* /*data*/) {}
+
+  // Render frames 0 to frame_count - 1 on worker_count threads. Workers
+  // stay at most max_pending frames ahead of the next frame to deliver,
+  // bounding memory and delivery latency. Returns false if the script
+  // failed to run or renderFrame threw, frames after the failed one are
+  // then not delivered. Call after v8 is set up, Run does not dispose v8.
+  bool Run(const std::string& script, int frame_count, int worker_count, int max_pending);
+};
+
+//////
+
+// Called once an external ArrayBuffer no longer references its data,
+// when the buffer is garbage collected or detached.
+typedef void (*ArrayBufferReleaseCallback)(void* data, uint32_t length, void* user_data);
+
+enum ArrayType {
+  kInt8Array,
+  kUint8Array,
+  kUint8ClampedArray,
+  kInt16Array,
+  kUint16Array,
+  kInt32Array,
+  kUint32Array,
+  kFloat32Array,
+  kFloat64Array
+};
+
+// Create an ArrayBuffer over embedder owned memory, without copying.
+// data must stay valid until release is called. release may be NULL.
+// Must be called with a v8 context entered, returns an empty handle on failure.
+v8::Handle<v8::Object> CreateExternalArrayBuffer(void* data, uint32_t length,
+                                                 ArrayBufferReleaseCallback release,
+                                                 void* user_data);
+
+// Create a typed array of length elements over embedder owned memory,
+// backed by an external ArrayBuffer. data must be aligned to the element size.
+v8::Handle<v8::Object> CreateExternalTypedArray(ArrayType type, void* data, uint32_t length,
+                                                ArrayBufferReleaseCallback release,
+                                                void* user_data);
+
+// Create an ArrayBuffer backed by a memory mapping of the file at path,
+// unmapped when the buffer is released. The file is always mapped
+// copy-on-write, script writes are never written to it. read_only does
+// not change the mapping.
+// Returns an empty handle if the file can't be mapped.
+v8::Handle<v8::Object> CreateMappedArrayBuffer(const char* path, bool read_only);
+
+// Release the data of an ArrayBuffer now, neutering it and all views on it.
+// Returns false if buffer is not an ArrayBuffer.
+bool DetachArrayBuffer(v8::Handle<v8::Object> buffer);
 
 }
 
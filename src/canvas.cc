@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "v8_binding.h"
+#include "v8_webgl_internal.h"
 #include "canvas.h"
 #include "webgl_rendering_context.h"
 
@@ -10,7 +11,7 @@
 namespace v8_webgl {
 
 
-//XXX Canvas is weak - maybe should be strong with dispose method?
+// Weak, scripts can call dispose() to release GL resources without waiting for GC.
 Canvas::Canvas(v8::Handle<v8::Object> instance)
     : V8Object<Canvas>(true, instance)
     , rendering_context_(0)
@@ -23,11 +24,13 @@ Canvas::~Canvas() {
 }
 
 //XXX need antialiasing flags
-WebGLRenderingContext* Canvas::GetRenderingContext() {
-  if (rendering_context_)
+WebGLRenderingContext* Canvas::GetRenderingContext(const ContextAttributes& attributes) {
+  if (rendering_context_ && !rendering_context_->is_disposed())
     return rendering_context_;
+  // Replace a context disposed by script, its instance keeps throwing
+  delete rendering_context_;
   // Context is not weak
-  rendering_context_ = new WebGLRenderingContext(width_, height_);
+  rendering_context_ = new WebGLRenderingContext(width_, height_, attributes);
   return rendering_context_;
 }
 
@@ -49,8 +52,37 @@ void Canvas::set_height(int height) {
 
 // WebGLRenderingContext getContext(DOMString type, hash);
 v8::Handle<v8::Value> Canvas::Callback_getContext(const v8::Arguments& args) {
-  //XXX validate first arg is "experimental-webgl", handle optional second arg params
-  return GetRenderingContext()->ToV8Object();
+  //XXX validate first arg is "experimental-webgl"
+  ContextAttributes attributes;
+  if (args.Length() > 1 && args[1]->IsObject()) {
+    v8::Local<v8::Object> options = args[1]->ToObject();
+    if (options->Get(v8::String::New("trustedShaders"))->BooleanValue()) {
+      if (GetFactory()->AllowTrustedShaders())
+        attributes.trusted_shaders = true;
+      else
+        WebGLRenderingContext::Log(Logger::kWarn, "%s: %s", "getContext", "trustedShaders not allowed.");
+    }
+    v8::Local<v8::Value> share_group = options->Get(v8::String::New("shareGroup"));
+    if (!share_group->IsUndefined() && !share_group->IsNull()) {
+      if (GetFactory()->CanShareGraphicContexts()) {
+        v8::String::Utf8Value name(share_group);
+        // Null if toString threw
+        if (!*name)
+          return v8::Undefined();
+        attributes.share_group = *name;
+      } else
+        WebGLRenderingContext::Log(Logger::kWarn, "%s: %s", "getContext", "shareGroup not supported.");
+    }
+  }
+  return GetRenderingContext(attributes)->ToV8Object();
+}
+
+// Not part of WebGL.
+// void dispose();
+// Disposes the rendering context and this canvas. Further calls throw.
+v8::Handle<v8::Value> Canvas::Callback_dispose(const v8::Arguments& args) {
+  delete this;
+  return v8::Undefined();
 }
 
 void Canvas::Setter_width(v8::Local<v8::String> property, v8::Local<v8::Value> value, const v8::AccessorInfo& info) {
@@ -82,6 +114,7 @@ void Canvas::ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> c
 #define PROTO_METHOD(name, argc) AddCallback(proto, #name, InvocationCallbackDispatcher<Canvas, argc, &Canvas::Callback_##name>, signature)
 
   PROTO_METHOD(getContext, 0); //XXX should be 1 args, "experimental-webgl" and optional options hash
+  PROTO_METHOD(dispose, 0);
 
 #undef PROTO_METHOD
 
@@ -9,6 +9,7 @@
 
 namespace v8_webgl {
 class WebGLRenderingContext;
+struct ContextAttributes;
 
 class Canvas : public V8Object<Canvas> {
  public:
@@ -16,7 +17,8 @@ class Canvas : public V8Object<Canvas> {
   static void ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor);
   static v8::Handle<v8::Value> ConstructorCallback(const v8::Arguments& args);
 
-  WebGLRenderingContext* GetRenderingContext(/*XXX antialias flags*/);
+  // Attributes are only used when the context is first created.
+  WebGLRenderingContext* GetRenderingContext(const ContextAttributes& attributes);
   int get_width() { return width_; }
   int get_height() { return height_; }
   void set_width(int width);
@@ -43,6 +45,7 @@ class Canvas : public V8Object<Canvas> {
 
 #define CALLBACK(name) v8::Handle<v8::Value> Callback_##name(const v8::Arguments& args)
   CALLBACK(getContext);
+  CALLBACK(dispose);
 #undef CALLBACK
 };
 
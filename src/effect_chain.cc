@@ -0,0 +1,210 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "effect_chain.h"
+#include "webgl_framebuffer.h"
+#include "webgl_rendering_context.h"
+#include "webgl_texture.h"
+
+namespace v8_webgl {
+
+EffectChainImpl::EffectChainImpl(v8::Handle<v8::Object> context, int width, int height)
+    : context_(v8::Persistent<v8::Object>::New(context))
+    , width_(width)
+    , height_(height)
+    , output_(-1) {
+}
+
+EffectChainImpl::~EffectChainImpl() {
+  v8::HandleScope scope;
+  WebGLRenderingContext* context = MakeCurrent();
+  for (int i = 0; i < 2; i++) {
+    if (context) {
+      WebGLFramebuffer* framebuffer = GetFramebuffer(i);
+      if (framebuffer) {
+        GLuint framebuffer_id = framebuffer->webgl_id();
+        glDeleteFramebuffers(1, &framebuffer_id);
+        context->DeleteFramebuffer(framebuffer);
+      }
+      WebGLTexture* texture = GetTexture(i);
+      if (texture) {
+        GLuint texture_id = texture->webgl_id();
+        glDeleteTextures(1, &texture_id);
+        context->DeleteTexture(texture);
+      }
+    }
+    textures_[i].Dispose();
+    textures_[i].Clear();
+    framebuffers_[i].Dispose();
+    framebuffers_[i].Clear();
+  }
+  for (size_t i = 0; i < effects_.size(); i++)
+    effects_[i].Dispose();
+  context_.Dispose();
+  context_.Clear();
+}
+
+WebGLRenderingContext* EffectChainImpl::MakeCurrent() {
+  WebGLRenderingContext* context = WebGLRenderingContext::FromV8Object(context_);
+  if (!context || context->is_disposed())
+    return 0;
+  context->MakeCurrent();
+  return context;
+}
+
+WebGLTexture* EffectChainImpl::GetTexture(int index) {
+  if (textures_[index].IsEmpty())
+    return 0;
+  WebGLTexture* texture = WebGLTexture::FromV8Object(textures_[index]);
+  return texture && !texture->is_deleted() ? texture : 0;
+}
+
+WebGLFramebuffer* EffectChainImpl::GetFramebuffer(int index) {
+  if (framebuffers_[index].IsEmpty())
+    return 0;
+  WebGLFramebuffer* framebuffer = WebGLFramebuffer::FromV8Object(framebuffers_[index]);
+  return framebuffer && !framebuffer->is_deleted() ? framebuffer : 0;
+}
+
+void EffectChainImpl::RestoreFramebuffer(WebGLRenderingContext* context, GLuint framebuffer_id) {
+  // Script may have deleted the framebuffer it had bound
+  if (framebuffer_id != context->default_framebuffer_ && !context->framebuffer_table_.Find(framebuffer_id))
+    framebuffer_id = context->default_framebuffer_;
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+}
+
+void EffectChainImpl::CreateTargets(WebGLRenderingContext* context) {
+  GLint texture_binding = 0;
+  GLint framebuffer_binding = 0;
+  WebGLRenderingContext::GetIntegerv(GL_TEXTURE_BINDING_2D, &texture_binding);
+  WebGLRenderingContext::GetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer_binding);
+
+  for (int i = 0; i < 2; i++) {
+    WebGLTexture* texture = GetTexture(i);
+    WebGLFramebuffer* framebuffer = GetFramebuffer(i);
+    if (texture && framebuffer)
+      continue;
+
+    if (!texture) {
+      GLuint texture_id = WebGLRenderingContext::TakeName(&context->name_pool_.textures, glGenTextures);
+      texture = context->CreateTexture(texture_id);
+      texture->set_has_been_bound();
+      textures_[i].Dispose();
+      textures_[i] = v8::Persistent<v8::Object>::New(texture->ToV8Object());
+
+      glBindTexture(GL_TEXTURE_2D, texture_id);
+      // Non power of two sizes need clamping and no mipmaps
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+      context->SetTextureLevelMemory(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, width_, height_);
+    }
+
+    if (!framebuffer) {
+      GLuint framebuffer_id = WebGLRenderingContext::TakeName(&context->name_pool_.framebuffers, glGenFramebuffers);
+      framebuffer = context->CreateFramebuffer(framebuffer_id);
+      framebuffer->set_has_been_bound();
+      framebuffers_[i].Dispose();
+      framebuffers_[i] = v8::Persistent<v8::Object>::New(framebuffer->ToV8Object());
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->webgl_id());
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->webgl_id(), 0);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, texture_binding);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_binding);
+}
+
+void EffectChainImpl::AddEffect(v8::Handle<v8::Function> effect) {
+  effects_.push_back(v8::Persistent<v8::Function>::New(effect));
+}
+
+bool EffectChainImpl::Run() {
+  WebGLRenderingContext* context = MakeCurrent();
+  if (!context)
+    return false;
+  if (effects_.empty())
+    return true;
+
+  v8::HandleScope scope;
+  CreateTargets(context);
+
+  // Targets may differ from the canvas size, restored below
+  GLint viewport[4] = { 0, 0, 0, 0 };
+  GLint framebuffer_binding = 0;
+  GLuint default_framebuffer = context->default_framebuffer_;
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  WebGLRenderingContext::GetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer_binding);
+
+  v8::Handle<v8::Object> global = v8::Context::GetCurrent()->Global();
+  v8::Handle<v8::Value> input = v8::Null();
+  bool ok = true;
+  for (size_t i = 0; i < effects_.size(); i++) {
+    int target = i % 2;
+    WebGLFramebuffer* framebuffer = GetFramebuffer(target);
+    if (!framebuffer) {
+      ok = false;
+      break;
+    }
+    context->set_default_framebuffer(framebuffer->webgl_id());
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->webgl_id());
+    glViewport(0, 0, width_, height_);
+    v8::Handle<v8::Value> argv[] = { context_, input };
+    // Exceptions are left to the caller's TryCatch
+    if (effects_[i]->Call(global, 2, argv).IsEmpty()) {
+      ok = false;
+      break;
+    }
+    // Script may have disposed the context or deleted our texture
+    context = MakeCurrent();
+    if (!context || !GetTexture(target)) {
+      ok = false;
+      break;
+    }
+    input = textures_[target];
+    output_ = target;
+  }
+
+  context = MakeCurrent();
+  if (context) {
+    context->set_default_framebuffer(default_framebuffer);
+    RestoreFramebuffer(context, framebuffer_binding);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  }
+  if (!ok)
+    output_ = -1;
+  return ok;
+}
+
+v8::Handle<v8::Object> EffectChainImpl::GetOutput() {
+  if (output_ < 0)
+    return v8::Handle<v8::Object>();
+  return textures_[output_];
+}
+
+bool EffectChainImpl::ReadPixels(void* pixels) {
+  if (output_ < 0)
+    return false;
+  WebGLRenderingContext* context = MakeCurrent();
+  if (!context || !GetTexture(output_))
+    return false;
+  WebGLFramebuffer* framebuffer = GetFramebuffer(output_);
+  if (!framebuffer)
+    return false;
+  GLint alignment = 4;
+  GLint framebuffer_binding = 0;
+  WebGLRenderingContext::GetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+  WebGLRenderingContext::GetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer_binding);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->webgl_id());
+  glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_binding);
+  glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+  return true;
+}
+
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8WEBGL_EFFECT_CHAIN_H
+#define V8WEBGL_EFFECT_CHAIN_H
+
+#include <v8.h>
+#include <v8_webgl.h>
+#include <vector>
+#include "gl.h"
+
+namespace v8_webgl {
+class WebGLFramebuffer;
+class WebGLRenderingContext;
+class WebGLTexture;
+
+class EffectChainImpl : public EffectChain {
+ public:
+  EffectChainImpl(v8::Handle<v8::Object> context, int width, int height);
+  ~EffectChainImpl();
+
+  void AddEffect(v8::Handle<v8::Function> effect);
+  bool Run();
+  v8::Handle<v8::Object> GetOutput();
+  bool ReadPixels(void* pixels);
+
+ private:
+  EffectChainImpl(const EffectChainImpl&);
+  EffectChainImpl& operator = (const EffectChainImpl&);
+
+  // Returns the context if it is still usable, made current.
+  WebGLRenderingContext* MakeCurrent();
+  // Returns the ping-pong texture, 0 if script deleted or disposed it.
+  WebGLTexture* GetTexture(int index);
+  // Returns the ping-pong framebuffer, 0 if script deleted or disposed it.
+  WebGLFramebuffer* GetFramebuffer(int index);
+  // Binds framebuffer_id if it still names a framebuffer of context,
+  // otherwise the default framebuffer.
+  void RestoreFramebuffer(WebGLRenderingContext* context, GLuint framebuffer_id);
+  // (Re)creates ping-pong textures and framebuffers as needed.
+  void CreateTargets(WebGLRenderingContext* context);
+
+  v8::Persistent<v8::Object> context_;
+  int width_;
+  int height_;
+  std::vector<v8::Persistent<v8::Function> > effects_;
+  // Owned by the context like script objects, so disposing the context
+  // deletes them too
+  v8::Persistent<v8::Object> textures_[2];
+  v8::Persistent<v8::Object> framebuffers_[2];
+  // Index of the target drawn by the last effect, -1 before Run
+  int output_;
+};
+
+}
+
+#endif
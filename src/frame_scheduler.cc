@@ -0,0 +1,187 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "v8_webgl_internal.h"
+#include <map>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace v8_webgl {
+
+// State shared by the workers of one FrameScheduler::Run, guarded by mutex.
+struct FrameQueue {
+  FrameQueue(FrameScheduler* scheduler, const std::string& script, int frame_count, int max_pending)
+      : scheduler(scheduler)
+      , script(script)
+      , frame_count(frame_count)
+      , max_pending(max_pending)
+      , next_frame(0)
+      , next_delivery(0)
+      , failed_frame(frame_count) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&frame_available, NULL);
+    pthread_cond_init(&frame_finished, NULL);
+  }
+  ~FrameQueue() {
+    pthread_cond_destroy(&frame_finished);
+    pthread_cond_destroy(&frame_available);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  // Returns the next frame to render, or -1 once all are taken or
+  // a frame failed. Blocks while max_pending frames are undelivered.
+  int TakeFrame() {
+    pthread_mutex_lock(&mutex);
+    while (next_frame < failed_frame && next_frame >= next_delivery + max_pending)
+      pthread_cond_wait(&frame_available, &mutex);
+    int frame = next_frame < failed_frame ? next_frame++ : -1;
+    pthread_mutex_unlock(&mutex);
+    return frame;
+  }
+
+  void FinishFrame(int frame, void* data) {
+    pthread_mutex_lock(&mutex);
+    finished[frame] = data;
+    pthread_cond_signal(&frame_finished);
+    pthread_mutex_unlock(&mutex);
+  }
+
+  // Frames from frame on are not rendered. Untaken frames are counted
+  // as failed so the delivering thread stops waiting for them.
+  void Fail(int frame) {
+    pthread_mutex_lock(&mutex);
+    if (frame < failed_frame)
+      failed_frame = frame;
+    if (next_frame > failed_frame)
+      next_frame = failed_frame;
+    pthread_cond_broadcast(&frame_available);
+    pthread_cond_signal(&frame_finished);
+    pthread_mutex_unlock(&mutex);
+  }
+
+  FrameScheduler* scheduler;
+  std::string script;
+  int frame_count;
+  int max_pending;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t frame_available;
+  pthread_cond_t frame_finished;
+  int next_frame;
+  int next_delivery;
+  // First frame not to deliver, frame_count unless a worker failed
+  int failed_frame;
+  // Finished frames waiting for delivery
+  std::map<int, void*> finished;
+};
+
+static void LogError(const char* message) {
+  Logger* logger = GetFactory()->GetLogger();
+  if (logger) {
+    std::string msg("FrameScheduler: ");
+    msg += message;
+    logger->Log(Logger::kError, msg);
+  }
+}
+
+static void LogException(const v8::TryCatch& try_catch) {
+  v8::String::Utf8Value message(try_catch.Exception());
+  LogError(*message ? *message : "exception");
+}
+
+// Render frames with the queue's script until no frames are left.
+// Runs in its own isolate, which is torn down before returning.
+static void RenderFrames(FrameQueue* queue) {
+  v8::Isolate* isolate = v8::Isolate::New();
+  {
+    v8::Locker locker(isolate);
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::HandleScope handle_scope;
+
+    v8::Persistent<v8::Context> context = v8::Context::New(NULL, Initialize(queue->scheduler->CreateFactory()));
+    {
+      v8::Context::Scope context_scope(context);
+      v8::TryCatch try_catch;
+      v8::Local<v8::Script> script = v8::Script::Compile(v8::String::New(queue->script.data(), queue->script.size()));
+      v8::Local<v8::Value> render_frame;
+      if (!script.IsEmpty() && !script->Run().IsEmpty())
+        render_frame = context->Global()->Get(v8::String::New("renderFrame"));
+
+      if (render_frame.IsEmpty() || !render_frame->IsFunction()) {
+        if (try_catch.HasCaught())
+          LogException(try_catch);
+        else
+          LogError("renderFrame is not a function.");
+        queue->Fail(0);
+      } else {
+        v8::Local<v8::Function> function = v8::Local<v8::Function>::Cast(render_frame);
+        for (int frame = queue->TakeFrame(); frame >= 0; frame = queue->TakeFrame()) {
+          v8::HandleScope frame_scope;
+          v8::Handle<v8::Value> argv[] = { v8::Integer::New(frame) };
+          v8::Local<v8::Value> result = function->Call(context->Global(), 1, argv);
+          if (result.IsEmpty()) {
+            LogException(try_catch);
+            queue->Fail(frame);
+            break;
+          }
+          queue->FinishFrame(frame, queue->scheduler->FinishFrame(frame, result));
+        }
+      }
+    }
+    context.Dispose();
+    Uninitialize(false);
+  }
+  isolate->Dispose();
+}
+
+static void* WorkerThread(void* data) {
+  RenderFrames(static_cast<FrameQueue*>(data));
+  return NULL;
+}
+
+bool FrameScheduler::Run(const std::string& script, int frame_count, int worker_count, int max_pending) {
+  if (worker_count < 1)
+    worker_count = 1;
+  if (max_pending < worker_count)
+    max_pending = worker_count;
+
+  FrameQueue queue(this, script, frame_count, max_pending);
+  std::vector<pthread_t> workers;
+  for (int i = 0; i < worker_count; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, WorkerThread, &queue) == 0)
+      workers.push_back(thread);
+  }
+  if (workers.empty())
+    queue.Fail(0);
+
+  pthread_mutex_lock(&queue.mutex);
+  while (queue.next_delivery < queue.failed_frame) {
+    std::map<int, void*>::iterator it = queue.finished.find(queue.next_delivery);
+    if (it == queue.finished.end()) {
+      pthread_cond_wait(&queue.frame_finished, &queue.mutex);
+      continue;
+    }
+    int frame = it->first;
+    void* data = it->second;
+    queue.finished.erase(it);
+    queue.next_delivery++;
+    pthread_cond_broadcast(&queue.frame_available);
+    // Deliver outside the lock so workers keep going
+    pthread_mutex_unlock(&queue.mutex);
+    DeliverFrame(frame, data);
+    pthread_mutex_lock(&queue.mutex);
+  }
+  pthread_mutex_unlock(&queue.mutex);
+
+  for (size_t i = 0; i < workers.size(); i++)
+    pthread_join(workers[i], NULL);
+
+  for (std::map<int, void*>::iterator it = queue.finished.begin(); it != queue.finished.end(); ++it)
+    DiscardFrame(it->first, it->second);
+  return queue.failed_frame == frame_count;
+}
+
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8WEBGL_OBJECT_POOL_H
+#define V8WEBGL_OBJECT_POOL_H
+
+#include <stddef.h>
+#include <new>
+
+namespace v8_webgl {
+
+// Base for short lived classes that are allocated and freed often.
+// Freed objects are kept on a per thread free list, up to kMaxFree,
+// and reused by the next allocation of the same class.
+template<class T>
+class PooledObject {
+ public:
+  enum { kMaxFree = 256 };
+
+  static void* operator new(size_t size) {
+    // Subclasses are bigger than the pooled blocks
+    if (size != sizeof(T) || !s_free_list)
+      return ::operator new(size);
+    FreeBlock* block = s_free_list;
+    s_free_list = block->next;
+    s_free_count--;
+    return block;
+  }
+
+  static void operator delete(void* data, size_t size) {
+    if (!data)
+      return;
+    if (size != sizeof(T) || s_free_count >= kMaxFree) {
+      ::operator delete(data);
+      return;
+    }
+    FreeBlock* block = static_cast<FreeBlock*>(data);
+    block->next = s_free_list;
+    s_free_list = block;
+    s_free_count++;
+  }
+
+  // Free all pooled blocks of the calling thread.
+  static void Trim() {
+    while (s_free_list) {
+      FreeBlock* block = s_free_list;
+      s_free_list = block->next;
+      ::operator delete(block);
+    }
+    s_free_count = 0;
+  }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  static __thread FreeBlock* s_free_list;
+  static __thread int s_free_count;
+};
+
+template<class T>
+__thread typename PooledObject<T>::FreeBlock* PooledObject<T>::s_free_list = 0;
+template<class T>
+__thread int PooledObject<T>::s_free_count = 0;
+
+}
+
+#endif
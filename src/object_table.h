@@ -0,0 +1,107 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8WEBGL_OBJECT_TABLE_H
+#define V8WEBGL_OBJECT_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include "gl.h"
+
+namespace v8_webgl {
+
+// Maps GL object names to objects. GL hands out small, mostly sequential
+// names, so slots are a vector indexed by name. Names too large for the
+// dense table go to an overflow map.
+template<class T>
+class ObjectTable {
+ public:
+  enum { kMaxDenseName = 1 << 16 };
+
+  ObjectTable() : size_(0) {}
+
+  T* Find(GLuint name) const {
+    if (name < slots_.size())
+      return slots_[name].object;
+    if (name < kMaxDenseName)
+      return 0;
+    typename OverflowMap::const_iterator it = overflow_.find(name);
+    return it == overflow_.end() ? 0 : it->second.object;
+  }
+
+  void Insert(GLuint name, T* object) {
+    Slot& slot = GetSlot(name);
+    if (!slot.object)
+      size_++;
+    slot.object = object;
+  }
+
+  // Returns the removed object, or 0 if name was not in the table.
+  T* Remove(GLuint name) {
+    Slot* slot = 0;
+    if (name < slots_.size())
+      slot = &slots_[name];
+    else if (name >= kMaxDenseName) {
+      typename OverflowMap::iterator it = overflow_.find(name);
+      if (it != overflow_.end())
+        slot = &it->second;
+    }
+    if (!slot || !slot->object)
+      return 0;
+    T* object = slot->object;
+    slot->object = 0;
+    size_--;
+    return object;
+  }
+
+  void GetObjects(std::vector<T*>* objects) const {
+    for (typename SlotVector::const_iterator it = slots_.begin(); it != slots_.end(); ++it) {
+      if (it->object)
+        objects->push_back(it->object);
+    }
+    for (typename OverflowMap::const_iterator it = overflow_.begin(); it != overflow_.end(); ++it) {
+      if (it->second.object)
+        objects->push_back(it->second.object);
+    }
+  }
+
+  // Delete all objects and empty the table.
+  void DeleteAll() {
+    for (typename SlotVector::iterator it = slots_.begin(); it != slots_.end(); ++it)
+      delete it->object;
+    for (typename OverflowMap::iterator it = overflow_.begin(); it != overflow_.end(); ++it)
+      delete it->second.object;
+    slots_.clear();
+    overflow_.clear();
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+
+ private:
+  struct Slot {
+    Slot() : object(0) {}
+    T* object;
+  };
+  typedef std::vector<Slot> SlotVector;
+  typedef std::map<GLuint, Slot> OverflowMap;
+
+  Slot& GetSlot(GLuint name) {
+    if (name >= kMaxDenseName)
+      return overflow_[name];
+    if (name >= slots_.size())
+      slots_.resize(name + 1);
+    return slots_[name];
+  }
+
+  SlotVector slots_;
+  OverflowMap overflow_;
+  size_t size_;
+};
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <v8.h>
+#include "pool_allocator.h"
+#include "runtime.h"
+
+
+namespace v8_webgl {
+
+// Size classes are 16 bytes to 4KB
+static const int kMinClassShift = 4;
+static const int kMaxClassShift = 12;
+static const int kClassCount = kMaxClassShift - kMinClassShift + 1;
+// Bytes cached per size class per thread
+static const uint32_t kMaxCachedBytes = 64 * 1024;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct ThreadPool {
+  FreeBlock* free_lists[kClassCount];
+  uint32_t cached_bytes[kClassCount];
+};
+
+static __thread ThreadPool* s_pool = NULL;
+static pthread_key_t s_pool_key;
+static pthread_once_t s_pool_key_once = PTHREAD_ONCE_INIT;
+
+static void ReleasePool(ThreadPool* pool) {
+  for (int i = 0; i < kClassCount; i++) {
+    FreeBlock* block = pool->free_lists[i];
+    while (block) {
+      FreeBlock* next = block->next;
+      free(block);
+      block = next;
+    }
+    pool->free_lists[i] = NULL;
+    pool->cached_bytes[i] = 0;
+  }
+}
+
+static void DestroyPool(void* data) {
+  ThreadPool* pool = static_cast<ThreadPool*>(data);
+  ReleasePool(pool);
+  free(pool);
+}
+
+static void CreatePoolKey() {
+  pthread_key_create(&s_pool_key, DestroyPool);
+}
+
+static ThreadPool* GetPool() {
+  if (!s_pool) {
+    pthread_once(&s_pool_key_once, CreatePoolKey);
+    s_pool = static_cast<ThreadPool*>(calloc(1, sizeof(ThreadPool)));
+    if (s_pool)
+      pthread_setspecific(s_pool_key, s_pool);
+  }
+  return s_pool;
+}
+
+// Returns -1 if length is too large to pool
+static int SizeClass(uint32_t length) {
+  if (length > (1u << kMaxClassShift))
+    return -1;
+  int shift = kMinClassShift;
+  while ((1u << shift) < length)
+    shift++;
+  return shift - kMinClassShift;
+}
+
+// Blocks are owned by the thread but accounted to the isolate using them,
+// a thread may run several isolates in turn.
+static void AdjustExternalMemory(intptr_t change) {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  Runtime* runtime = isolate ? Runtime::From(isolate) : NULL;
+  if (runtime)
+    runtime->AdjustExternalMemory(change);
+  else
+    v8::V8::AdjustAmountOfExternalAllocatedMemory(change);
+}
+
+void* PoolAllocator::Allocate(uint32_t length) {
+  if (length == 0)
+    return NULL;
+
+  ThreadPool* pool = GetPool();
+  int size_class = SizeClass(length);
+  void* data = NULL;
+  if (pool && size_class >= 0) {
+    FreeBlock* block = pool->free_lists[size_class];
+    if (block) {
+      pool->free_lists[size_class] = block->next;
+      pool->cached_bytes[size_class] -= 1u << (size_class + kMinClassShift);
+      // Recycled blocks are dirty, only the requested length needs zeroing
+      memset(block, 0, length);
+      data = block;
+    }
+    else
+      data = calloc(1, 1u << (size_class + kMinClassShift));
+  }
+  else
+    data = calloc(length, 1);
+
+  if (data)
+    AdjustExternalMemory(length);
+  return data;
+}
+
+void PoolAllocator::Free(void* data, uint32_t length) {
+  if (!data)
+    return;
+
+  ThreadPool* pool = GetPool();
+  int size_class = SizeClass(length);
+  if (pool && size_class >= 0) {
+    uint32_t size = 1u << (size_class + kMinClassShift);
+    if (pool->cached_bytes[size_class] + size <= kMaxCachedBytes) {
+      FreeBlock* block = static_cast<FreeBlock*>(data);
+      block->next = pool->free_lists[size_class];
+      pool->free_lists[size_class] = block;
+      pool->cached_bytes[size_class] += size;
+    }
+    else
+      free(data);
+  }
+  else
+    free(data);
+
+  AdjustExternalMemory(-static_cast<intptr_t>(length));
+}
+
+void PoolAllocator::Trim() {
+  if (s_pool)
+    ReleasePool(s_pool);
+}
+
+}
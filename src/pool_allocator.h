@@ -0,0 +1,32 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8WEBGL_POOL_ALLOCATOR_H
+#define V8WEBGL_POOL_ALLOCATOR_H
+
+#include <stdint.h>
+
+namespace v8_webgl {
+
+// Allocator for ArrayBuffer backing stores.
+// Small blocks are rounded up to a power of two size class and recycled
+// through per thread free lists, so the small arrays scripts create every
+// frame do not go through malloc. Larger blocks use calloc/free directly.
+// External memory is batched per isolate, see Runtime::AdjustExternalMemory.
+class PoolAllocator {
+ public:
+  // Returns zero filled storage for length bytes, or NULL on failure.
+  // Returns NULL for a zero length.
+  static void* Allocate(uint32_t length);
+  // length must be the length passed to Allocate.
+  static void Free(void* data, uint32_t length);
+
+  // Release all cached blocks for this thread. Pools of other threads
+  // are released when those threads exit.
+  static void Trim();
+};
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "runtime.h"
+#include "share_group.h"
+#include "webgl_rendering_context.h"
+
+namespace v8_webgl {
+
+// Pending external memory change before it is reported to v8
+static const intptr_t kExternalMemoryThreshold = 256 * 1024;
+
+Runtime::Runtime(Factory* factory)
+    : factory_(factory)
+    , context_counter_(0)
+    , current_context_(0)
+    , graphic_context_pool_size_(0)
+    , has_shader_resources_(false)
+    , pending_external_memory_(0) {
+  v8::HandleScope scope;
+  global_ = v8::Persistent<v8::ObjectTemplate>::New(v8::ObjectTemplate::New());
+}
+
+Runtime::~Runtime() {
+  global_.Dispose();
+  global_.Clear();
+  // Groups are deleted with their last context, which Uninitialize collects
+  for (std::map<std::string, ShareGroup*>::iterator it = share_groups_.begin(); it != share_groups_.end(); ++it)
+    delete it->second;
+  for (size_t i = 0; i < idle_graphic_contexts_.size(); i++)
+    delete idle_graphic_contexts_[i];
+  delete factory_;
+}
+
+Runtime* Runtime::New(Factory* factory) {
+  Runtime* runtime = new Runtime(factory);
+  v8::Isolate::GetCurrent()->SetData(runtime);
+  return runtime;
+}
+
+ShareGroup* Runtime::JoinShareGroup(const std::string& name, WebGLRenderingContext* context) {
+  ShareGroup* group = 0;
+  if (name.empty()) {
+    // Objects of unshared contexts are owned by the context itself
+    group = new ShareGroup(context->get_context_id(), name);
+  } else {
+    std::map<std::string, ShareGroup*>::iterator it = share_groups_.find(name);
+    if (it != share_groups_.end())
+      group = it->second;
+    else {
+      group = new ShareGroup(NextContextId(), name);
+      share_groups_[name] = group;
+    }
+  }
+  group->AddContext(context);
+  return group;
+}
+
+void Runtime::LeaveShareGroup(ShareGroup* group, WebGLRenderingContext* context) {
+  group->RemoveContext(context);
+  if (!group->contexts().empty())
+    return;
+  if (!group->name().empty())
+    share_groups_.erase(group->name());
+  delete group;
+}
+
+void Runtime::ReleaseCurrentContext() {
+  if (!current_context_)
+    return;
+  current_context_->ReleaseCurrent();
+  current_context_ = 0;
+}
+
+void Runtime::PrewarmGraphicContexts(int count, int width, int height) {
+  if (count <= 0)
+    return;
+  current_context_ = 0;
+  graphic_context_pool_size_ += count;
+  for (int i = 0; i < count; i++) {
+    GraphicContext* context = factory_->CreateGraphicContext(width, height);
+    // Drivers finish context setup on first use
+    context->MakeCurrent();
+    idle_graphic_contexts_.push_back(context);
+  }
+}
+
+GraphicContext* Runtime::LeaseGraphicContext(int width, int height) {
+  if (idle_graphic_contexts_.empty())
+    return factory_->CreateGraphicContext(width, height);
+  GraphicContext* context = idle_graphic_contexts_.back();
+  idle_graphic_contexts_.pop_back();
+  context->Resize(width, height);
+  return context;
+}
+
+void Runtime::ReleaseGraphicContext(GraphicContext* context) {
+  if (CanPoolGraphicContext())
+    idle_graphic_contexts_.push_back(context);
+  else
+    delete context;
+}
+
+void Runtime::AdjustExternalMemory(intptr_t change) {
+  pending_external_memory_ += change;
+  if (pending_external_memory_ >= kExternalMemoryThreshold ||
+      pending_external_memory_ <= -kExternalMemoryThreshold)
+    FlushExternalMemory();
+}
+
+void Runtime::FlushExternalMemory() {
+  if (pending_external_memory_ == 0)
+    return;
+  v8::V8::AdjustAmountOfExternalAllocatedMemory(pending_external_memory_);
+  pending_external_memory_ = 0;
+}
+
+void Runtime::Delete() {
+  Runtime* runtime = Current();
+  v8::Isolate::GetCurrent()->SetData(NULL);
+  delete runtime;
+}
+
+}
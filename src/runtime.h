@@ -0,0 +1,115 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8WEBGL_RUNTIME_H
+#define V8WEBGL_RUNTIME_H
+
+#include <v8.h>
+#include <v8_webgl.h>
+#include <GLSLANG/ShaderLang.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace v8_webgl {
+class ShareGroup;
+class WebGLRenderingContext;
+
+// State of v8-webgl for one isolate, stored in the isolate's data.
+// Isolates each have their own Runtime, so they can be used on different
+// threads without sharing any v8 handles or locking each other.
+class Runtime {
+ public:
+  enum { kMaxClasses = 64 };
+
+  // Per V8Object class state, indexed by V8Object<T>::class_index().
+  struct ClassData {
+    ClassData() : allow_construction(false) {}
+    v8::Persistent<v8::FunctionTemplate> constructor_template;
+    v8::Persistent<v8::ObjectTemplate> instance_template;
+    // Set while ConstructorMode is active
+    bool allow_construction;
+    // Cached property names
+    std::vector<v8::Persistent<v8::String> > symbols;
+  };
+
+  // Creates the Runtime of the current isolate, taking ownership of factory.
+  static Runtime* New(Factory* factory);
+  // Deletes the Runtime of the current isolate.
+  static void Delete();
+
+  // Runtime of the current isolate, NULL if v8-webgl is not initialized on it.
+  static Runtime* Current() {
+    return static_cast<Runtime*>(v8::Isolate::GetCurrent()->GetData());
+  }
+  // Runtime of isolate, which need not be entered.
+  static Runtime* From(v8::Isolate* isolate) {
+    return static_cast<Runtime*>(isolate->GetData());
+  }
+
+  Factory* factory() { return factory_; }
+  v8::Persistent<v8::ObjectTemplate> global() { return global_; }
+  ClassData& class_data(int class_index) { return classes_[class_index]; }
+  unsigned long NextContextId() { return context_counter_++; }
+
+  // Adds context to the ShareGroup called name, created if needed.
+  // Contexts with an empty name get a group of their own.
+  ShareGroup* JoinShareGroup(const std::string& name, WebGLRenderingContext* context);
+  // Deletes group once its last context left.
+  void LeaveShareGroup(ShareGroup* group, WebGLRenderingContext* context);
+
+  // WebGLRenderingContext current on the thread using the isolate,
+  // NULL if none is, see ReleaseCurrentContext.
+  WebGLRenderingContext* current_context() { return current_context_; }
+  void set_current_context(WebGLRenderingContext* context) { current_context_ = context; }
+  // Release the current context from the calling thread.
+  void ReleaseCurrentContext();
+
+  // Create count idle graphic contexts. Up to count contexts are kept
+  // idle from then on, released contexts beyond that are deleted.
+  void PrewarmGraphicContexts(int count, int width, int height);
+  // Returns an idle graphic context resized to width x height,
+  // or a new one if none are idle.
+  GraphicContext* LeaseGraphicContext(int width, int height);
+  // Keeps context idle if there is room, otherwise deletes it.
+  // Idle contexts must be returned with WebGL default state.
+  void ReleaseGraphicContext(GraphicContext* context);
+  bool CanPoolGraphicContext() { return idle_graphic_contexts_.size() < graphic_context_pool_size_; }
+
+  // Translator limits queried from the first context, all contexts
+  // come from the same Factory. NULL until set.
+  const ShBuiltInResources* shader_resources() {
+    return has_shader_resources_ ? &shader_resources_ : 0;
+  }
+  void set_shader_resources(const ShBuiltInResources& resources) {
+    shader_resources_ = resources;
+    has_shader_resources_ = true;
+  }
+
+  // Batch an external memory change for this isolate, reported to v8
+  // once the pending total crosses a threshold.
+  void AdjustExternalMemory(intptr_t change);
+  // Report any pending external memory change to v8 now.
+  void FlushExternalMemory();
+
+ private:
+  Runtime(Factory* factory);
+  ~Runtime();
+
+  Factory* factory_;
+  v8::Persistent<v8::ObjectTemplate> global_;
+  ClassData classes_[kMaxClasses];
+  unsigned long context_counter_;
+  std::map<std::string, ShareGroup*> share_groups_;
+  WebGLRenderingContext* current_context_;
+  std::vector<GraphicContext*> idle_graphic_contexts_;
+  size_t graphic_context_pool_size_;
+  ShBuiltInResources shader_resources_;
+  bool has_shader_resources_;
+  intptr_t pending_external_memory_;
+};
+
+}
+
+#endif
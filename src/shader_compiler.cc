@@ -3,34 +3,67 @@
 // found in the LICENSE file.
 
 #include "shader_compiler.h"
+#include "runtime.h"
 #include "webgl_rendering_context.h"
+#include <pthread.h>
 #include <vector>
 
 namespace v8_webgl {
 
+// The ANGLE translator keeps process wide state (the preprocessor's cpp
+// struct and atom table, and its thread local storage setup), so isolates
+// on different threads must not use it at the same time.
+static pthread_mutex_t s_translator_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+class TranslatorLock {
+ public:
+  TranslatorLock() { pthread_mutex_lock(&s_translator_mutex); }
+  ~TranslatorLock() { pthread_mutex_unlock(&s_translator_mutex); }
+ private:
+  TranslatorLock(const TranslatorLock&);
+  TranslatorLock& operator = (const TranslatorLock&);
+};
+
 ShaderCompiler::~ShaderCompiler() {
   DestroyCompilers();
 }
 
-void ShaderCompiler::Init(WebGLRenderingContext* context) {
-  ShInitialize();
-  ShInitBuiltInResources(&resources_);
+void ShaderCompiler::Init(WebGLRenderingContext* context, bool trusted_shaders) {
+  {
+    TranslatorLock lock;
+    ShInitialize();
+  }
+  spec_ = trusted_shaders ? SH_GLES2_SPEC : SH_WEBGL_SPEC;
 
   context->MakeCurrent();
+  GetResources(&resources_);
+}
+
+void ShaderCompiler::GetResources(ShBuiltInResources* resources) {
+  Runtime* runtime = Runtime::Current();
+  if (runtime->shader_resources()) {
+    *resources = *runtime->shader_resources();
+    return;
+  }
+
+  ShInitBuiltInResources(resources);
 
-  context->GetIntegerv(GL_MAX_VERTEX_ATTRIBS, &resources_.MaxVertexAttribs);
-  context->GetIntegerv(GL_MAX_VERTEX_UNIFORM_VECTORS, &resources_.MaxVertexUniformVectors);
-  context->GetIntegerv(GL_MAX_VARYING_VECTORS, &resources_.MaxVaryingVectors);
-  context->GetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &resources_.MaxVertexTextureImageUnits);
-  context->GetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &resources_.MaxCombinedTextureImageUnits); 
-  context->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &resources_.MaxTextureImageUnits);
-  context->GetIntegerv(GL_MAX_FRAGMENT_UNIFORM_VECTORS, &resources_.MaxFragmentUniformVectors);
+  WebGLRenderingContext::GetIntegerv(GL_MAX_VERTEX_ATTRIBS, &resources->MaxVertexAttribs);
+  WebGLRenderingContext::GetIntegerv(GL_MAX_VERTEX_UNIFORM_VECTORS, &resources->MaxVertexUniformVectors);
+  WebGLRenderingContext::GetIntegerv(GL_MAX_VARYING_VECTORS, &resources->MaxVaryingVectors);
+  WebGLRenderingContext::GetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &resources->MaxVertexTextureImageUnits);
+  WebGLRenderingContext::GetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &resources->MaxCombinedTextureImageUnits);
+  WebGLRenderingContext::GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &resources->MaxTextureImageUnits);
+  WebGLRenderingContext::GetIntegerv(GL_MAX_FRAGMENT_UNIFORM_VECTORS, &resources->MaxFragmentUniformVectors);
 
   // Always set to 1 for OpenGL ES.
-  resources_.MaxDrawBuffers = 1;
+  resources->MaxDrawBuffers = 1;
+
+  runtime->set_shader_resources(*resources);
 }
 
 void ShaderCompiler::DestroyCompilers() {
+  TranslatorLock lock;
   if (fragment_compiler_)
     ShDestruct(fragment_compiler_);
   fragment_compiler_ = 0;
@@ -41,10 +74,39 @@ void ShaderCompiler::DestroyCompilers() {
   built_compilers_ = false;
 }
 
-bool ShaderCompiler::TranslateShaderSource(const char* shader_source, GLenum shader_type, std::string* translated_shader_source, std::string* shader_log) {
+// Collect attribute or uniform info from the last successful ShCompile.
+static void GetVariables(ShHandle compiler, bool attributes, ShaderVariableList* variables) {
+  variables->clear();
+  int count = 0;
+  int max_name_length = 0;
+  int max_mapped_name_length = 0;
+  ShGetInfo(compiler, attributes ? SH_ACTIVE_ATTRIBUTES : SH_ACTIVE_UNIFORMS, &count);
+  ShGetInfo(compiler, attributes ? SH_ACTIVE_ATTRIBUTE_MAX_LENGTH : SH_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+  ShGetInfo(compiler, SH_MAPPED_NAME_MAX_LENGTH, &max_mapped_name_length);
+  if (count <= 0 || max_name_length <= 0)
+    return;
+  std::vector<char> name(max_name_length);
+  std::vector<char> mapped_name(max_mapped_name_length > 0 ? max_mapped_name_length : 1);
+  variables->reserve(count);
+  for (int i = 0; i < count; i++) {
+    int length = 0;
+    int size = 0;
+    ShDataType type = SH_NONE;
+    if (attributes)
+      ShGetActiveAttrib(compiler, i, &length, &size, &type, &name[0], &mapped_name[0]);
+    else
+      ShGetActiveUniform(compiler, i, &length, &size, &type, &name[0], &mapped_name[0]);
+    variables->push_back(ShaderVariable(size, type, std::string(&name[0], length)));
+  }
+}
+
+bool ShaderCompiler::TranslateShaderSource(const char* shader_source, GLenum shader_type, std::string* translated_shader_source, std::string* shader_log, ShaderVariableList* attributes, ShaderVariableList* uniforms) {
   if (!built_compilers_) {
-    fragment_compiler_ = ShConstructCompiler(SH_FRAGMENT_SHADER, SH_WEBGL_SPEC, SH_GLSL_OUTPUT, &resources_);
-    vertex_compiler_ = ShConstructCompiler(SH_VERTEX_SHADER, SH_WEBGL_SPEC, SH_GLSL_OUTPUT, &resources_);
+    {
+      TranslatorLock lock;
+      fragment_compiler_ = ShConstructCompiler(SH_FRAGMENT_SHADER, spec_, SH_GLSL_OUTPUT, &resources_);
+      vertex_compiler_ = ShConstructCompiler(SH_VERTEX_SHADER, spec_, SH_GLSL_OUTPUT, &resources_);
+    }
     if (!fragment_compiler_ || !vertex_compiler_) {
       DestroyCompilers();
       return false;
@@ -53,6 +115,9 @@ bool ShaderCompiler::TranslateShaderSource(const char* shader_source, GLenum sha
     built_compilers_ = true;
   }
 
+  // Also held while the results are read back from the compiler
+  TranslatorLock lock;
+
   ShHandle compiler;
   if (shader_type == GL_VERTEX_SHADER)
     compiler = vertex_compiler_;
@@ -61,8 +126,10 @@ bool ShaderCompiler::TranslateShaderSource(const char* shader_source, GLenum sha
 
   const char* const shader_source_strings[] = { shader_source };
 
-  bool is_valid = ShCompile(compiler, shader_source_strings, 1, SH_OBJECT_CODE);
+  bool is_valid = ShCompile(compiler, shader_source_strings, 1, SH_OBJECT_CODE | SH_ATTRIBUTES_UNIFORMS);
   if (!is_valid) {
+    attributes->clear();
+    uniforms->clear();
     int log_size = 0;
     ShGetInfo(compiler, SH_INFO_LOG_LENGTH, &log_size);
     if (log_size > 1) {
@@ -80,6 +147,9 @@ bool ShaderCompiler::TranslateShaderSource(const char* shader_source, GLenum sha
     ShGetObjectCode(compiler, &buffer[0]);
     translated_shader_source->assign(&buffer[0], translated_source_length - 1);
   }
+
+  GetVariables(compiler, true, attributes);
+  GetVariables(compiler, false, uniforms);
   return true;
 }
 
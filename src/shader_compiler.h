@@ -8,21 +8,41 @@
 #include "gl.h"
 #include <GLSLANG/ShaderLang.h>
 #include <string>
+#include <vector>
 
 namespace v8_webgl {
 class WebGLRenderingContext;
 
+// Attribute or uniform reported by the translator.
+// Array names end in "[0]", as from glGetActiveUniform.
+struct ShaderVariable {
+  ShaderVariable(GLint size, GLenum type, const std::string& name)
+      : size(size)
+      , type(type)
+      , name(name) {}
+  GLint size;
+  GLenum type;
+  std::string name;
+};
+typedef std::vector<ShaderVariable> ShaderVariableList;
+
 class ShaderCompiler {
  public:
   ShaderCompiler()
-      : built_compilers_(false)
+      : spec_(SH_WEBGL_SPEC)
+      , built_compilers_(false)
       , fragment_compiler_(0)
       , vertex_compiler_(0) {}
   ~ShaderCompiler();
 
-  void Init(WebGLRenderingContext* context);
+  // Trusted shaders are compiled to the GLSL ES spec, which skips the
+  // WebGL restrictions on loops and indexing.
+  void Init(WebGLRenderingContext* context, bool trusted_shaders = false);
+  // Translator limits of the current GL context. Queried once per Runtime.
+  static void GetResources(ShBuiltInResources* resources);
   bool TranslateShaderSource(const char* shader_source, GLenum shader_type,
-                             std::string* translated_shader_source, std::string* shader_log);
+                             std::string* translated_shader_source, std::string* shader_log,
+                             ShaderVariableList* attributes, ShaderVariableList* uniforms);
 
  private:
   ShaderCompiler(const ShaderCompiler&);
@@ -31,6 +51,7 @@ class ShaderCompiler {
   void DestroyCompilers();
 
   ShBuiltInResources resources_;
+  ShShaderSpec spec_;
   bool built_compilers_;
   ShHandle fragment_compiler_;
   ShHandle vertex_compiler_;
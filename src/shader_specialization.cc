@@ -0,0 +1,150 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "shader_specialization.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+
+namespace v8_webgl {
+
+bool SpecializationLiteral(GLenum type, double value, std::string* literal) {
+  char buf[32];
+  switch (type) {
+    case GL_FLOAT: {
+      snprintf(buf, sizeof(buf), "%.9g", value);
+      *literal = buf;
+      // GLSL ES float literals need a decimal point or exponent
+      if (literal->find_first_of(".e") == std::string::npos)
+        *literal += ".0";
+      return true;
+    }
+    case GL_INT:
+      // Also rejects NaN, which compares unequal to itself
+      if (value != floor(value) || value < INT_MIN || value > INT_MAX)
+        return false;
+      snprintf(buf, sizeof(buf), "%d", static_cast<int>(value));
+      *literal = buf;
+      return true;
+    case GL_BOOL:
+      *literal = value ? "true" : "false";
+      return true;
+    default:
+      return false;
+  }
+}
+
+static inline bool IsIdentifierStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool IsIdentifierChar(char c) {
+  return IsIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+// Skip whitespace and comments starting at pos.
+static size_t SkipSpace(const std::string& source, size_t pos) {
+  size_t length = source.length();
+  while (pos < length) {
+    char c = source[pos];
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v') {
+      pos++;
+    } else if (c == '/' && pos + 1 < length && source[pos + 1] == '/') {
+      pos = source.find('\n', pos);
+      if (pos == std::string::npos)
+        return length;
+    } else if (c == '/' && pos + 1 < length && source[pos + 1] == '*') {
+      pos = source.find("*/", pos + 2);
+      if (pos == std::string::npos)
+        return length;
+      pos += 2;
+    } else {
+      break;
+    }
+  }
+  return pos;
+}
+
+// Read an identifier at pos, returns the position after it.
+static size_t ReadIdentifier(const std::string& source, size_t pos, std::string* identifier) {
+  size_t start = pos;
+  if (pos < source.length() && IsIdentifierStart(source[pos])) {
+    while (pos < source.length() && IsIdentifierChar(source[pos]))
+      pos++;
+  }
+  identifier->assign(source, start, pos - start);
+  return pos;
+}
+
+// Try to rewrite a uniform declaration whose "uniform" keyword ends at pos.
+// Returns the position after the declaration, or 0 if not rewritten.
+static size_t RewriteDeclaration(const std::string& source, size_t pos, const SpecializationConstants& constants, std::string* result) {
+  std::string precision;
+  std::string type;
+  std::string name;
+  pos = ReadIdentifier(source, SkipSpace(source, pos), &type);
+  if (type == "lowp" || type == "mediump" || type == "highp") {
+    precision = type;
+    pos = ReadIdentifier(source, SkipSpace(source, pos), &type);
+  }
+  pos = ReadIdentifier(source, SkipSpace(source, pos), &name);
+  if (type.empty() || name.empty())
+    return 0;
+  pos = SkipSpace(source, pos);
+  if (pos >= source.length() || source[pos] != ';')
+    return 0;
+  SpecializationConstants::const_iterator it = constants.find(name);
+  if (it == constants.end())
+    return 0;
+
+  result->append("const ");
+  if (!precision.empty())
+    result->append(precision).append(" ");
+  result->append(type).append(" ").append(name).append(" = ").append(it->second).append(";");
+  return pos + 1;
+}
+
+std::string SpecializeShaderSource(const std::string& source, const SpecializationConstants& constants) {
+  std::string result;
+  result.reserve(source.length() + 64);
+  size_t length = source.length();
+  size_t pos = 0;
+  while (pos < length) {
+    size_t next = SkipSpace(source, pos);
+    if (next != pos) {
+      result.append(source, pos, next - pos);
+      pos = next;
+      continue;
+    }
+    if (!IsIdentifierStart(source[pos])) {
+      // Consume the whole token so digits are not read as identifiers
+      do {
+        result += source[pos++];
+      } while (pos < length && IsIdentifierChar(source[pos]) && IsIdentifierChar(source[pos - 1]));
+      continue;
+    }
+    std::string identifier;
+    next = ReadIdentifier(source, pos, &identifier);
+    if (identifier == "uniform") {
+      size_t end = RewriteDeclaration(source, next, constants, &result);
+      if (end) {
+        pos = end;
+        continue;
+      }
+    }
+    result.append(source, pos, next - pos);
+    pos = next;
+  }
+  return result;
+}
+
+std::string SpecializationKey(const SpecializationConstants& constants) {
+  std::string key;
+  SpecializationConstants::const_iterator it;
+  for (it = constants.begin(); it != constants.end(); it++)
+    key.append(it->first).append("=").append(it->second).append(";");
+  return key;
+}
+
+}
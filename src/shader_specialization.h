@@ -0,0 +1,32 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8WEBGL_SHADER_SPECIALIZATION_H
+#define V8WEBGL_SHADER_SPECIALIZATION_H
+
+#include "gl.h"
+#include <map>
+#include <string>
+
+namespace v8_webgl {
+
+// Uniform name to GLSL literal value.
+typedef std::map<std::string, std::string> SpecializationConstants;
+
+// Format value as a GLSL ES literal for a scalar uniform of type
+// GL_FLOAT, GL_INT or GL_BOOL. Returns false for other types, and for
+// GL_INT values that are not integers in int range.
+bool SpecializationLiteral(GLenum type, double value, std::string* literal);
+
+// Rewrite "uniform [precision] type name;" declarations of the given
+// constants as "const [precision] type name = literal;".
+// Uniforms declared in a list or as arrays are left as they are.
+std::string SpecializeShaderSource(const std::string& source, const SpecializationConstants& constants);
+
+// Variant cache key, unique per set of constant values.
+std::string SpecializationKey(const SpecializationConstants& constants);
+
+}
+
+#endif
@@ -0,0 +1,14 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "share_group.h"
+#include <algorithm>
+
+namespace v8_webgl {
+
+void ShareGroup::RemoveContext(WebGLRenderingContext* context) {
+  contexts_.erase(std::remove(contexts_.begin(), contexts_.end(), context), contexts_.end());
+}
+
+}
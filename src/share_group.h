@@ -0,0 +1,51 @@
+// Copyright (c) 2012 Hewlett-Packard Development Company, L.P. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8WEBGL_SHARE_GROUP_H
+#define V8WEBGL_SHARE_GROUP_H
+
+#include "object_table.h"
+#include <string>
+#include <vector>
+
+namespace v8_webgl {
+class WebGLBuffer;
+class WebGLRenderingContext;
+class WebGLTexture;
+
+// Contexts created with the same shareGroup attribute share a GL object
+// namespace, created with Factory::CreateSharedGraphicContext. Their
+// buffers and textures are valid in all contexts of the group.
+// Contexts without a shareGroup have an unnamed group of their own.
+class ShareGroup {
+ public:
+  ShareGroup(unsigned long id, const std::string& name)
+      : id_(id)
+      , name_(name) {}
+
+  // Owner of shared objects, see MakeObjectOwner.
+  unsigned long id() { return id_; }
+  const std::string& name() { return name_; }
+
+  void AddContext(WebGLRenderingContext* context) { contexts_.push_back(context); }
+  void RemoveContext(WebGLRenderingContext* context);
+  const std::vector<WebGLRenderingContext*>& contexts() { return contexts_; }
+
+  ObjectTable<WebGLBuffer>& buffer_table() { return buffer_table_; }
+  ObjectTable<WebGLTexture>& texture_table() { return texture_table_; }
+
+ private:
+  ShareGroup(const ShareGroup&);
+  ShareGroup& operator = (const ShareGroup&);
+
+  unsigned long id_;
+  std::string name_;
+  std::vector<WebGLRenderingContext*> contexts_;
+  ObjectTable<WebGLBuffer> buffer_table_;
+  ObjectTable<WebGLTexture> texture_table_;
+};
+
+}
+
+#endif
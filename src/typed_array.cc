@@ -2,7 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "v8_binding.h"
+#include "v8_webgl_internal.h"
+#include "pool_allocator.h"
 #include "typed_array.h"
 
 
@@ -12,12 +18,39 @@ ArrayBuffer::ArrayBuffer(void* data, uint32_t data_length, v8::Handle<v8::Object
     : V8Object<ArrayBuffer>(true, instance)
     , data_length_(data_length)
     , data_(data)
+    , release_callback_(NULL)
+    , release_data_(NULL)
+    , report_external_memory_(false)
+    , first_view_(NULL)
 {
 }
 
 ArrayBuffer::~ArrayBuffer() {
-  free(data_);
-  v8::V8::AdjustAmountOfExternalAllocatedMemory(-data_length_);
+  ArrayBufferViewBase* view = first_view_;
+  while (view) {
+    ArrayBufferViewBase* next = view->next_view_;
+    view->buffer_ = NULL;
+    view->prev_view_ = view->next_view_ = NULL;
+    view = next;
+  }
+  ReleaseData();
+}
+
+void ArrayBuffer::ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor) {
+  v8::Handle<v8::ObjectTemplate> proto = constructor->PrototypeTemplate();
+  v8::Handle<v8::ObjectTemplate> instance = constructor->InstanceTemplate();
+  v8::Local<v8::Signature> signature = v8::Signature::New(constructor);
+
+  AddCallback(proto, "slice", InvocationCallbackDispatcher<ArrayBuffer, 1, &ArrayBuffer::Callback_slice>, signature);
+  SetAccessor(instance, "byteLength", AccessorGetterDispatcher<ArrayBuffer, &ArrayBuffer::Getter_byteLength>, 0);
+
+  // Not part of the Typed Array spec.
+  constructor->Set(v8::String::New("transfer"),
+                   v8::FunctionTemplate::New(InvocationCallbackCatcher<ArrayBuffer::Callback_transfer>),
+                   v8::DontDelete);
+  constructor->Set(v8::String::New("mapFile"),
+                   v8::FunctionTemplate::New(InvocationCallbackCatcher<ArrayBuffer::Callback_mapFile>),
+                   v8::DontDelete);
 }
 
 v8::Handle<v8::Object> ArrayBuffer::Create(uint32_t length) {
@@ -25,6 +58,57 @@ v8::Handle<v8::Object> ArrayBuffer::Create(uint32_t length) {
   return V8Object<ArrayBuffer>::Create(1, argv);
 }
 
+// Release callback for external buffers whose embedder does not need notifying
+static void IgnoreRelease(void*, uint32_t, void*) {}
+
+v8::Handle<v8::Object> ArrayBuffer::CreateExternal(void* data, uint32_t length,
+                                                   ArrayBufferReleaseCallback release_callback,
+                                                   void* release_data,
+                                                   bool report_external_memory) {
+  v8::Handle<v8::Object> buffer_value = Create(0);
+  if (buffer_value.IsEmpty())
+    return buffer_value;
+  ArrayBuffer* buffer = FromV8Object(buffer_value);
+  buffer->SetData(data, length, release_callback ? release_callback : IgnoreRelease, release_data);
+  buffer->report_external_memory_ = report_external_memory;
+  if (report_external_memory)
+    v8::V8::AdjustAmountOfExternalAllocatedMemory(length);
+  return buffer_value;
+}
+
+static void UnmapFile(void* data, uint32_t length, void*) {
+  munmap(data, length);
+}
+
+v8::Handle<v8::Object> ArrayBuffer::CreateMapped(const char* path, bool /*read_only*/) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return v8::Handle<v8::Object>();
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || static_cast<uint64_t>(st.st_size) > 0xffffffffu) {
+    close(fd);
+    return v8::Handle<v8::Object>();
+  }
+  uint32_t length = static_cast<uint32_t>(st.st_size);
+  if (length == 0) {
+    close(fd);
+    return Create(0);
+  }
+
+  // Scripts can write to any ArrayBuffer, so the mapping must be writable.
+  // MAP_PRIVATE makes writes copy-on-write, they never reach the file.
+  void* data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return v8::Handle<v8::Object>();
+
+  // Mapped pages are backed by the page cache, don't count them as heap pressure
+  v8::Handle<v8::Object> buffer_value = CreateExternal(data, length, UnmapFile, NULL, false);
+  if (buffer_value.IsEmpty())
+    munmap(data, length);
+  return buffer_value;
+}
+
 // ArrayBuffer(unsigned long length)
 v8::Handle<v8::Value> ArrayBuffer::ConstructorCallback(const v8::Arguments& args) {
   uint32_t length = 0;
@@ -35,23 +119,295 @@ v8::Handle<v8::Value> ArrayBuffer::ConstructorCallback(const v8::Arguments& args
     if (!ok)
       return v8::Undefined();
 
-    data = calloc(length, 1);
-    if (!data)
+    data = PoolAllocator::Allocate(length);
+    if (!data && length > 0)
       return ThrowError("Unable to allocate ArrayBuffer.");
   }
 
   v8::Handle<v8::Object> self(args.This());
 
-  SetProperty(self, "byteLength", ToV8(length));
-
-  //XXX need ArrayBuffer slice(long begin, optional long end)
-
   new ArrayBuffer(data, length, self);
   self->SetIndexedPropertiesToExternalArrayData(data, v8::kExternalUnsignedByteArray, length);
 
-  v8::V8::AdjustAmountOfExternalAllocatedMemory(length);
+  return self;
+}
+
+void ArrayBuffer::SetData(void* data, uint32_t data_length, ArrayBufferReleaseCallback release_callback, void* release_data) {
+  data_ = data;
+  data_length_ = data_length;
+  release_callback_ = release_callback;
+  release_data_ = release_data;
+  ToV8Object()->SetIndexedPropertiesToExternalArrayData(data, v8::kExternalUnsignedByteArray, data_length);
+}
+
+void ArrayBuffer::Neuter() {
+  ArrayBufferViewBase* view = first_view_;
+  first_view_ = NULL;
+  while (view) {
+    ArrayBufferViewBase* next = view->next_view_;
+    view->prev_view_ = view->next_view_ = NULL;
+    view->Neuter();
+    view = next;
+  }
+  SetData(NULL, 0, NULL, NULL);
+}
+
+void ArrayBuffer::AddView(ArrayBufferViewBase* view) {
+  view->prev_view_ = NULL;
+  view->next_view_ = first_view_;
+  if (first_view_)
+    first_view_->prev_view_ = view;
+  first_view_ = view;
+}
+
+void ArrayBuffer::RemoveView(ArrayBufferViewBase* view) {
+  if (view->prev_view_)
+    view->prev_view_->next_view_ = view->next_view_;
+  else
+    first_view_ = view->next_view_;
+  if (view->next_view_)
+    view->next_view_->prev_view_ = view->prev_view_;
+  view->prev_view_ = view->next_view_ = NULL;
+}
+
+void ArrayBuffer::ReleaseData() {
+  // External buffers are accounted when created, not by PoolAllocator
+  if (release_callback_) {
+    if (report_external_memory_)
+      v8::V8::AdjustAmountOfExternalAllocatedMemory(-static_cast<intptr_t>(data_length_));
+    release_callback_(data_, data_length_, release_data_);
+  }
+  else
+    PoolAllocator::Free(data_, data_length_);
+}
+
+void ArrayBuffer::Detach() {
+  ReleaseData();
+  Neuter();
+}
+
+v8::Handle<v8::Object> ArrayBuffer::Transfer() {
+  v8::Handle<v8::Object> buffer_value = Create(0);
+  if (buffer_value.IsEmpty())
+    return buffer_value;
+  ArrayBuffer* buffer = FromV8Object(buffer_value);
+  buffer->SetData(data_, data_length_, release_callback_, release_data_);
+  buffer->report_external_memory_ = report_external_memory_;
+  // Ownership moved to the new buffer
+  data_ = NULL;
+  data_length_ = 0;
+  release_callback_ = NULL;
+  release_data_ = NULL;
+  Neuter();
+  return buffer_value;
+}
+
+v8::Handle<v8::Value> ArrayBuffer::Getter_byteLength(v8::Local<v8::String> property, const v8::AccessorInfo& info) {
+  return ToV8(data_length_);
+}
+
+// ArrayBuffer slice(long begin, optional long end)
+v8::Handle<v8::Value> ArrayBuffer::Callback_slice(const v8::Arguments& args) {
+  bool ok = true;
+  int64_t begin_index = FromV8<int32_t>(args[0], &ok);
+  if (!ok)
+    return v8::Undefined();
+  int64_t end_index = data_length_;
+  if (args.Length() >= 2) {
+    end_index = FromV8<int32_t>(args[1], &ok);
+    if (!ok)
+      return v8::Undefined();
+  }
+
+  uint32_t begin = ClampArrayIndex(begin_index, data_length_);
+  uint32_t end = ClampArrayIndex(end_index, data_length_);
+  if (end < begin)
+    end = begin;
+
+  v8::Handle<v8::Object> buffer_value = Create(end - begin);
+  if (buffer_value.IsEmpty())
+    return v8::Undefined();
+  if (end > begin) {
+    ArrayBuffer* buffer = FromV8Object(buffer_value);
+    memcpy(buffer->data_, static_cast<char*>(data_) + begin, end - begin);
+  }
+  return buffer_value;
+}
+
+// Not part of the Typed Array spec.
+// static ArrayBuffer transfer(ArrayBuffer buffer)
+v8::Handle<v8::Value> ArrayBuffer::Callback_transfer(const v8::Arguments& args) {
+  if (args.Length() < 1)
+    return ThrowArgCount();
+  bool ok = true;
+  ArrayBuffer* buffer = NativeFromV8<ArrayBuffer>(args[0], &ok);
+  if (!ok || !buffer)
+    return ThrowTypeError();
+  return buffer->Transfer();
+}
+
+// Not part of the Typed Array spec.
+// static ArrayBuffer mapFile(DOMString path, optional object options)
+v8::Handle<v8::Value> ArrayBuffer::Callback_mapFile(const v8::Arguments& args) {
+  if (args.Length() < 1)
+    return ThrowArgCount();
+  bool ok = true;
+  std::string path = FromV8<std::string>(args[0], &ok);
+  if (!ok)
+    return v8::Undefined();
+  bool read_only = true;
+  if (args.Length() >= 2 && args[1]->IsObject()) {
+    v8::Local<v8::Value> value = args[1]->ToObject()->Get(v8::String::New("readOnly"));
+    if (!value->IsUndefined())
+      read_only = value->BooleanValue();
+  }
+
+  if (!GetFactory()->CanMapFile(path, read_only))
+    return ThrowError("Not allowed to map file.");
+
+  v8::Handle<v8::Object> buffer_value = CreateMapped(path.c_str(), read_only);
+  if (buffer_value.IsEmpty())
+    return ThrowError("Unable to map file.");
+  return buffer_value;
+}
+
+//////
+
+ArrayBufferViewBase::ArrayBufferViewBase(ArrayBuffer* buffer, uint32_t byte_offset, uint32_t byte_length)
+    : buffer_(buffer)
+    , byte_offset_(byte_offset)
+    , byte_length_(byte_length)
+    , prev_view_(NULL)
+    , next_view_(NULL)
+{
+  if (buffer_)
+    buffer_->AddView(this);
+}
+
+ArrayBufferViewBase::~ArrayBufferViewBase() {
+  if (buffer_)
+    buffer_->RemoveView(this);
+}
+
+void ArrayBufferViewBase::NeuterView() {
+  buffer_ = NULL;
+  byte_offset_ = 0;
+  byte_length_ = 0;
+}
+
+//////
+
+void ArrayBufferView::Initialize(v8::Handle<v8::ObjectTemplate> global) {
+  V8Object<ArrayBufferView>::Initialize(global);
+  std::vector<v8::Persistent<v8::String> >& symbols = class_data().symbols;
+  if (!symbols.empty())
+    return;
+  v8::HandleScope scope;
+  symbols.resize(kSymbolCount);
+  symbols[kBufferSymbol] = v8::Persistent<v8::String>::New(v8::String::NewSymbol("buffer"));
+  symbols[kByteLengthSymbol] = v8::Persistent<v8::String>::New(v8::String::NewSymbol("byteLength"));
+  symbols[kByteOffsetSymbol] = v8::Persistent<v8::String>::New(v8::String::NewSymbol("byteOffset"));
+  symbols[kLengthSymbol] = v8::Persistent<v8::String>::New(v8::String::NewSymbol("length"));
+}
+
+void ArrayBufferView::Uninitialize() {
+  V8Object<ArrayBufferView>::Uninitialize();
+  std::vector<v8::Persistent<v8::String> >& symbols = class_data().symbols;
+  for (size_t i = 0; i < symbols.size(); i++)
+    symbols[i].Dispose();
+  symbols.clear();
+}
+
+//////
+
+DataView::DataView(ArrayBuffer* buffer, uint32_t byte_offset, uint32_t byte_length, v8::Handle<v8::Object> instance)
+    : V8Object<DataView>(true, instance)
+    , ArrayBufferViewBase(buffer, byte_offset, byte_length)
+{
+}
+
+void DataView::ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor) {
+  // In JS, DataView inherits from ArrayBufferView
+  ArrayBufferView::Reparent(constructor);
+
+  v8::Handle<v8::ObjectTemplate> proto = constructor->PrototypeTemplate();
+  v8::Handle<v8::ObjectTemplate> instance = constructor->InstanceTemplate();
+  v8::Local<v8::Signature> signature = v8::Signature::New(constructor);
+
+  instance->SetInternalFieldCount(ArrayBufferView::kInternalFieldCount);
+  instance->SetAccessor(ArrayBufferView::buffer_symbol(), AccessorGetterDispatcher<DataView, &DataView::Getter_buffer>);
+  instance->SetAccessor(ArrayBufferView::byte_offset_symbol(), AccessorGetterDispatcher<DataView, &DataView::Getter_byteOffset>);
+  instance->SetAccessor(ArrayBufferView::byte_length_symbol(), AccessorGetterDispatcher<DataView, &DataView::Getter_byteLength>);
+
+#define PROTO_METHOD(name, callback, type, argc) AddCallback(proto, #name, InvocationCallbackDispatcher<DataView, argc, &DataView::Callback_##callback<type> >, signature)
+
+  PROTO_METHOD(getInt8, get, int8_t, 1);
+  PROTO_METHOD(getUint8, get, uint8_t, 1);
+  PROTO_METHOD(getInt16, get, int16_t, 1);
+  PROTO_METHOD(getUint16, get, uint16_t, 1);
+  PROTO_METHOD(getInt32, get, int32_t, 1);
+  PROTO_METHOD(getUint32, get, uint32_t, 1);
+  PROTO_METHOD(getFloat32, get, float, 1);
+  PROTO_METHOD(getFloat64, get, double, 1);
+  PROTO_METHOD(setInt8, set, int8_t, 2);
+  PROTO_METHOD(setUint8, set, uint8_t, 2);
+  PROTO_METHOD(setInt16, set, int16_t, 2);
+  PROTO_METHOD(setUint16, set, uint16_t, 2);
+  PROTO_METHOD(setInt32, set, int32_t, 2);
+  PROTO_METHOD(setUint32, set, uint32_t, 2);
+  PROTO_METHOD(setFloat32, set, float, 2);
+  PROTO_METHOD(setFloat64, set, double, 2);
+
+#undef PROTO_METHOD
+}
+
+// DataView(ArrayBuffer buffer, optional unsigned long byteOffset, optional unsigned long byteLength)
+v8::Handle<v8::Value> DataView::ConstructorCallback(const v8::Arguments& args) {
+  bool ok = true;
+  if (!ArrayBuffer::HasInstance(args[0]))
+    return ThrowTypeError();
+  ArrayBuffer* buffer = NativeFromV8<ArrayBuffer>(args[0], &ok);
+  if (!ok || !buffer)
+    return v8::Undefined();
+  uint32_t buflen = buffer->GetArrayLength();
+
+  uint32_t byte_offset = 0;
+  if (args.Length() >= 2) {
+    byte_offset = FromV8<uint32_t>(args[1], &ok);
+    if (!ok)
+      return v8::Undefined();
+    if (byte_offset > buflen)
+      return ThrowRangeError("Byte offset out of range.");
+  }
+
+  uint32_t byte_length = buflen - byte_offset;
+  if (args.Length() >= 3) {
+    byte_length = FromV8<uint32_t>(args[2], &ok);
+    if (!ok)
+      return v8::Undefined();
+    if (byte_length > buflen - byte_offset)
+      return ThrowRangeError("Length out of range.");
+  }
+
+  v8::Handle<v8::Object> self(args.This());
+
+  self->SetInternalField(ArrayBufferView::kBufferField, args[0]);
+
+  new DataView(buffer, byte_offset, byte_length, self);
 
   return self;
 }
 
+v8::Handle<v8::Value> DataView::Getter_buffer(v8::Local<v8::String> property, const v8::AccessorInfo& info) {
+  return ToV8Object()->GetInternalField(ArrayBufferView::kBufferField);
+}
+
+v8::Handle<v8::Value> DataView::Getter_byteOffset(v8::Local<v8::String> property, const v8::AccessorInfo& info) {
+  return ToV8(byte_offset());
+}
+
+v8::Handle<v8::Value> DataView::Getter_byteLength(v8::Local<v8::String> property, const v8::AccessorInfo& info) {
+  return ToV8(byte_length());
+}
+
 }
@@ -9,10 +9,16 @@
 #ifndef V8WEBGL_TYPED_ARRAY_H
 #define V8WEBGL_TYPED_ARRAY_H
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <v8_webgl.h>
 #include "v8_binding.h"
 
 namespace v8_webgl {
 
+class ArrayBufferViewBase;
+
 class ArrayDataInterface {
  public:
   virtual ~ArrayDataInterface() {}
@@ -26,36 +32,260 @@ class ArrayDataInterface {
 class ArrayBuffer : public V8Object<ArrayBuffer>, public ArrayDataInterface {
  public:
   static const char* const ClassName() { return "ArrayBuffer"; }
+  static void ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor);
   static v8::Handle<v8::Value> ConstructorCallback(const v8::Arguments& args);
 
   void* GetArrayData() { return data_; }
   uint32_t GetArrayLength() { return data_length_; }
 
   static v8::Handle<v8::Object> Create(uint32_t length);
+  // Wrap memory owned by the embedder, release_callback is called when the
+  // buffer no longer references it.
+  // If report_external_memory, length is reported to v8 as external memory.
+  static v8::Handle<v8::Object> CreateExternal(void* data, uint32_t length,
+                                               ArrayBufferReleaseCallback release_callback,
+                                               void* release_data,
+                                               bool report_external_memory = true);
+  // Map a file copy-on-write, unmapped when the buffer is released.
+  // The file is never modified, read_only is only a hint for CanMapFile.
+  // Returns an empty handle if the file can't be mapped.
+  static v8::Handle<v8::Object> CreateMapped(const char* path, bool read_only);
+
+  // Release the contents now, this buffer and all views on it are left
+  // with zero length.
+  void Detach();
+
+  // Move the contents into a new ArrayBuffer without copying.
+  // This buffer and all views on it are left with zero length.
+  v8::Handle<v8::Object> Transfer();
 
  protected:
   ArrayBuffer(void* data, uint32_t data_length, v8::Handle<v8::Object> instance = v8::Local<v8::Object>());
   ~ArrayBuffer();
 
  private:
+  void SetData(void* data, uint32_t data_length, ArrayBufferReleaseCallback release_callback, void* release_data);
+  void ReleaseData();
+  void Neuter();
+
+  void AddView(ArrayBufferViewBase* view);
+  void RemoveView(ArrayBufferViewBase* view);
+
   uint32_t data_length_;
   void* data_;
+  ArrayBufferReleaseCallback release_callback_;
+  void* release_data_;
+  bool report_external_memory_;
+  // Views are linked through ArrayBufferViewBase, so adding and removing
+  // one allocates nothing.
+  ArrayBufferViewBase* first_view_;
+
+  friend class ArrayBufferViewBase;
+
+#define GETTER(name) v8::Handle<v8::Value> Getter_##name(v8::Local<v8::String>, const v8::AccessorInfo&)
+  GETTER(byteLength);
+#undef GETTER
+
+#define CALLBACK(name) v8::Handle<v8::Value> Callback_##name(const v8::Arguments& args)
+  CALLBACK(slice);
+#undef CALLBACK
+
+  static v8::Handle<v8::Value> Callback_transfer(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Callback_mapFile(const v8::Arguments& args);
+};
+
+//////
+
+// Native state shared by TypedArray and DataView. Views register with their
+// ArrayBuffer so they can be neutered when its contents are transferred.
+class ArrayBufferViewBase {
+ public:
+  ArrayBuffer* buffer() { return buffer_; }
+  uint32_t byte_offset() { return byte_offset_; }
+  uint32_t byte_length() { return byte_length_; }
+
+ protected:
+  ArrayBufferViewBase(ArrayBuffer* buffer, uint32_t byte_offset, uint32_t byte_length);
+  virtual ~ArrayBufferViewBase();
+
+  // Called when the buffer contents are transferred.
+  virtual void Neuter() = 0;
+  // Detach from the buffer and zero the view offset and length.
+  void NeuterView();
+
+ private:
+  ArrayBuffer* buffer_;
+  uint32_t byte_offset_;
+  uint32_t byte_length_;
+  // Links in buffer_'s list of views
+  ArrayBufferViewBase* prev_view_;
+  ArrayBufferViewBase* next_view_;
+
+  friend class ArrayBuffer;
 };
 
 //////
 
 class ArrayBufferView : public V8Object<ArrayBufferView> {
  public:
+  static void Initialize(v8::Handle<v8::ObjectTemplate> global);
+  static void Uninitialize();
   static void ConfigureGlobal(v8::Handle<v8::ObjectTemplate>) {
     // Don't expose "ArrayBufferView" constructor name
   }
   static const char* const ClassName() { return "ArrayBufferView"; }
+
+  // Views keep their ArrayBuffer alive in this internal field
+  enum { kBufferField = 1, kInternalFieldCount };
+
+  // Cached property names
+  static v8::Handle<v8::String> buffer_symbol() { return symbol(kBufferSymbol); }
+  static v8::Handle<v8::String> byte_length_symbol() { return symbol(kByteLengthSymbol); }
+  static v8::Handle<v8::String> byte_offset_symbol() { return symbol(kByteOffsetSymbol); }
+  static v8::Handle<v8::String> length_symbol() { return symbol(kLengthSymbol); }
+
+ private:
+  enum Symbol { kBufferSymbol, kByteLengthSymbol, kByteOffsetSymbol, kLengthSymbol, kSymbolCount };
+  static v8::Handle<v8::String> symbol(Symbol symbol) {
+    return class_data().symbols[symbol];
+  }
 };
 
 //////
 
+// Resolve a slice/subarray index, negative indices count from the end.
+// Computed in 64 bits, lengths over 2GB don't fit an int32_t.
+inline uint32_t ClampArrayIndex(int64_t index, uint32_t length) {
+  if (index < 0)
+    index += length;
+  if (index < 0)
+    return 0;
+  if (index > length)
+    return length;
+  return static_cast<uint32_t>(index);
+}
+
+//////
+
+// Element conversions with the semantics of storing a number into a typed array.
+
+// Integer types truncate and wrap modulo 2^n, NaN and infinity store 0.
+template<typename TNative>
+struct ElementConverter {
+  static TNative FromDouble(double value) {
+    if (value != value || value == HUGE_VAL || value == -HUGE_VAL)
+      return 0;
+    value = fmod(value < 0 ? ceil(value) : floor(value), 4294967296.0);
+    if (value < 0)
+      value += 4294967296.0;
+    return static_cast<TNative>(static_cast<uint32_t>(value));
+  }
+  template<typename TSource>
+  static TNative Convert(TSource value) { return static_cast<TNative>(value); }
+  static TNative Convert(float value) { return FromDouble(value); }
+  static TNative Convert(double value) { return FromDouble(value); }
+};
+
+template<>
+struct ElementConverter<float> {
+  static float FromDouble(double value) { return static_cast<float>(value); }
+  template<typename TSource>
+  static float Convert(TSource value) { return static_cast<float>(value); }
+};
+
+template<>
+struct ElementConverter<double> {
+  static double FromDouble(double value) { return value; }
+  template<typename TSource>
+  static double Convert(TSource value) { return static_cast<double>(value); }
+};
+
+// Uint8ClampedArray clamps to [0, 255] and rounds half to even.
+struct ClampedElementConverter {
+  static uint8_t FromDouble(double value) {
+    if (!(value > 0))
+      return 0;
+    if (value >= 255)
+      return 255;
+    double rounded = floor(value + 0.5);
+    if (rounded - value == 0.5 && fmod(rounded, 2) != 0)
+      rounded -= 1;
+    return static_cast<uint8_t>(rounded);
+  }
+  template<typename TSource>
+  static uint8_t Convert(TSource value) { return FromDouble(static_cast<double>(value)); }
+};
+
+template<v8::ExternalArrayType TArrayType, typename TNative>
+struct ArrayTypeConverter : ElementConverter<TNative> {};
+
+template<>
+struct ArrayTypeConverter<v8::kExternalPixelArray, uint8_t> : ClampedElementConverter {};
+
+inline uint32_t ExternalArrayElementSize(v8::ExternalArrayType type) {
+  switch (type) {
+    case v8::kExternalShortArray:
+    case v8::kExternalUnsignedShortArray:
+      return 2;
+    case v8::kExternalIntArray:
+    case v8::kExternalUnsignedIntArray:
+    case v8::kExternalFloatArray:
+      return 4;
+    case v8::kExternalDoubleArray:
+      return 8;
+    default:
+      return 1;
+  }
+}
+
+template<typename TConverter, typename TNative, typename TSource>
+inline void ConvertElements(TNative* dst, const TSource* src, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++)
+    dst[i] = TConverter::Convert(src[i]);
+}
+
+// Convert length elements of external array data of type src_type into dst.
+// dst and src must not overlap unless the types match.
+template<v8::ExternalArrayType TArrayType, typename TNative>
+void CopyExternalArrayData(TNative* dst, const void* src, v8::ExternalArrayType src_type, uint32_t length) {
+  typedef ArrayTypeConverter<TArrayType, TNative> Converter;
+  if (src_type == TArrayType) {
+    memmove(dst, src, length * sizeof(TNative));
+    return;
+  }
+  switch (src_type) {
+    case v8::kExternalByteArray:
+      ConvertElements<Converter>(dst, static_cast<const int8_t*>(src), length);
+      break;
+    case v8::kExternalUnsignedByteArray:
+    case v8::kExternalPixelArray:
+      ConvertElements<Converter>(dst, static_cast<const uint8_t*>(src), length);
+      break;
+    case v8::kExternalShortArray:
+      ConvertElements<Converter>(dst, static_cast<const int16_t*>(src), length);
+      break;
+    case v8::kExternalUnsignedShortArray:
+      ConvertElements<Converter>(dst, static_cast<const uint16_t*>(src), length);
+      break;
+    case v8::kExternalIntArray:
+      ConvertElements<Converter>(dst, static_cast<const int32_t*>(src), length);
+      break;
+    case v8::kExternalUnsignedIntArray:
+      ConvertElements<Converter>(dst, static_cast<const uint32_t*>(src), length);
+      break;
+    case v8::kExternalFloatArray:
+      ConvertElements<Converter>(dst, static_cast<const float*>(src), length);
+      break;
+    case v8::kExternalDoubleArray:
+      ConvertElements<Converter>(dst, static_cast<const double*>(src), length);
+      break;
+  }
+}
+
+//////
+
 template<class T, v8::ExternalArrayType TArrayType, typename TNative>
-class TypedArray : public V8Object<T>, public ArrayDataInterface {
+class TypedArray : public V8Object<T>, public ArrayDataInterface, public ArrayBufferViewBase {
  public:
   static v8::Handle<v8::Object> Create(TNative* values, uint32_t length) {
     v8::Handle<v8::Value> argv[1] = { ToV8(length) };
@@ -69,6 +299,12 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
     return array;
   }
 
+  // Create a view of length elements on buffer.
+  static v8::Handle<v8::Object> Create(v8::Handle<v8::Object> buffer, uint32_t byte_offset, uint32_t length) {
+    v8::Handle<v8::Value> argv[3] = { buffer, ToV8(byte_offset), ToV8(length) };
+    return V8Object<T>::Create(3, argv);
+  }
+
   static void ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor) {
     // In JS, TypedArray inherits from ArrayBufferView
     ArrayBufferView::Reparent(constructor);
@@ -78,7 +314,15 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
     v8::Local<v8::Signature> signature = v8::Signature::New(constructor);
 
     V8ObjectBase::AddConstant("BYTES_PER_ELEMENT", ToV8<uint32_t>(sizeof(TNative)), proto, constructor);
-    //XXX need subarray and set() with array arg
+    V8ObjectBase::AddCallback(proto, "set", InvocationCallbackDispatcher<TypedArray, 1, &TypedArray::Callback_set>, signature);
+    V8ObjectBase::AddCallback(proto, "subarray", InvocationCallbackDispatcher<TypedArray, 1, &TypedArray::Callback_subarray>, signature);
+
+    // Accessors live in the shared instance map rather than per instance properties
+    instance->SetInternalFieldCount(ArrayBufferView::kInternalFieldCount);
+    instance->SetAccessor(ArrayBufferView::buffer_symbol(), AccessorGetterDispatcher<TypedArray, &TypedArray::Getter_buffer>);
+    instance->SetAccessor(ArrayBufferView::length_symbol(), AccessorGetterDispatcher<TypedArray, &TypedArray::Getter_length>);
+    instance->SetAccessor(ArrayBufferView::byte_offset_symbol(), AccessorGetterDispatcher<TypedArray, &TypedArray::Getter_byteOffset>);
+    instance->SetAccessor(ArrayBufferView::byte_length_symbol(), AccessorGetterDispatcher<TypedArray, &TypedArray::Getter_byteLength>);
   }
 
   // TypedArray(unsigned long length)
@@ -88,6 +332,7 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
   static v8::Handle<v8::Value> ConstructorCallback(const v8::Arguments& args) {
     bool ok = true;
     v8::Handle<v8::Object> buffer_value;
+    ArrayBuffer* buffer = NULL;
     uint32_t length = 0;
     uint32_t byte_offset = 0;
 
@@ -95,7 +340,7 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
 
     // TypedArray(ArrayBuffer buffer, optional unsigned long byteOffset, optional unsigned long length)
     if (ArrayBuffer::HasInstance(args[0])) {
-      ArrayBuffer* buffer = NativeFromV8<ArrayBuffer>(args[0], &ok);
+      buffer = NativeFromV8<ArrayBuffer>(args[0], &ok);
       if (!ok)
         return v8::Undefined();
       buffer_value = v8::Handle<v8::Object>::Cast(args[0]);
@@ -129,7 +374,7 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
         length = (buflen - byte_offset) / sizeof(TNative);
       }
 
-      if (byte_offset >= buflen || byte_offset + length * sizeof(TNative) > buflen)
+      if (byte_offset > buflen || length > (buflen - byte_offset) / sizeof(TNative))
         return ThrowRangeError("Length out of range.");
 
       void* data = buffer->GetArrayData();
@@ -140,24 +385,41 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
     // TypedArray(type[] array)
     else if (args[0]->IsObject()) {
       v8::Local<v8::Object> object = v8::Local<v8::Object>::Cast(args[0]);
-      length = FromV8<uint32_t>(object->Get(v8::String::New("length")), &ok);
-      if (!ok)
-        return v8::Undefined();
+      bool is_typed_array = object->HasIndexedPropertiesInExternalArrayData();
+      if (is_typed_array)
+        length = object->GetIndexedPropertiesExternalArrayDataLength();
+      else if (object->IsArray())
+        length = v8::Local<v8::Array>::Cast(object)->Length();
+      else {
+        length = FromV8<uint32_t>(object->Get(ArrayBufferView::length_symbol()), &ok);
+        if (!ok)
+          return v8::Undefined();
+      }
 
       buffer_value = ArrayBuffer::Create(length * sizeof(TNative));
       if (buffer_value.IsEmpty())
         return v8::Undefined();
-      ArrayBuffer* buffer = NativeFromV8<ArrayBuffer>(buffer_value, &ok);
+      buffer = NativeFromV8<ArrayBuffer>(buffer_value, &ok);
       if (!ok)
         return v8::Undefined();
 
-      void* buf = buffer->GetArrayData();
+      TNative* data = static_cast<TNative*>(buffer->GetArrayData());
       self->SetIndexedPropertiesToExternalArrayData
-          (buf, TArrayType, length);
+          (data, TArrayType, length);
 
-      // Copy array data
-      for (uint32_t i = 0; i < length; i++)
-        self->Set(i, object->Get(i));
+      // Copy array data directly into the new buffer
+      if (is_typed_array) {
+        CopyExternalArrayData<TArrayType>(data, object->GetIndexedPropertiesExternalArrayData(),
+                                          object->GetIndexedPropertiesExternalArrayDataType(), length);
+      }
+      else {
+        for (uint32_t i = 0; i < length; i++) {
+          v8::Local<v8::Value> value = object->Get(i);
+          if (value.IsEmpty())
+            return v8::Undefined();
+          data[i] = Converter::FromDouble(value->NumberValue());
+        }
+      }
     }
     // TypedArray(unsigned long length)
     else {
@@ -170,7 +432,7 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
       buffer_value = ArrayBuffer::Create(length * sizeof(TNative));
       if (buffer_value.IsEmpty())
         return v8::Undefined();
-      ArrayBuffer* buffer = NativeFromV8<ArrayBuffer>(buffer_value, &ok);
+      buffer = NativeFromV8<ArrayBuffer>(buffer_value, &ok);
       if (!ok)
         return v8::Undefined();
 
@@ -178,12 +440,9 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
           (buffer->GetArrayData(), TArrayType, length);
     }
 
-    V8ObjectBase::SetProperty(self, "buffer", buffer_value);
-    V8ObjectBase::SetProperty(self, "length", ToV8(length));
-    V8ObjectBase::SetProperty(self, "byteOffset", ToV8(byte_offset));
-    V8ObjectBase::SetProperty(self, "byteLength", ToV8<uint32_t>(length * sizeof(TNative)));
+    self->SetInternalField(ArrayBufferView::kBufferField, buffer_value);
 
-    new T(self);
+    new T(buffer, byte_offset, length * sizeof(TNative), self);
 
     return self;
   }
@@ -207,8 +466,127 @@ class TypedArray : public V8Object<T>, public ArrayDataInterface {
   }
 
  protected:
-  TypedArray<T, TArrayType, TNative>(v8::Handle<v8::Object> instance)
-  : V8Object<T>(true, instance) {}
+  typedef ArrayTypeConverter<TArrayType, TNative> Converter;
+
+  TypedArray<T, TArrayType, TNative>(ArrayBuffer* buffer, uint32_t byte_offset, uint32_t byte_length, v8::Handle<v8::Object> instance)
+      : V8Object<T>(true, instance)
+      , ArrayBufferViewBase(buffer, byte_offset, byte_length) {}
+
+  void Neuter() {
+    this->ToV8Object()->SetIndexedPropertiesToExternalArrayData(NULL, TArrayType, 0);
+    NeuterView();
+  }
+
+  v8::Handle<v8::Value> Getter_buffer(v8::Local<v8::String>, const v8::AccessorInfo&) {
+    return this->ToV8Object()->GetInternalField(ArrayBufferView::kBufferField);
+  }
+
+  v8::Handle<v8::Value> Getter_length(v8::Local<v8::String>, const v8::AccessorInfo&) {
+    return ToV8(GetTypedArrayLength());
+  }
+
+  v8::Handle<v8::Value> Getter_byteOffset(v8::Local<v8::String>, const v8::AccessorInfo&) {
+    return ToV8(byte_offset());
+  }
+
+  v8::Handle<v8::Value> Getter_byteLength(v8::Local<v8::String>, const v8::AccessorInfo&) {
+    return ToV8(byte_length());
+  }
+
+  // void set(TypedArray array, optional unsigned long offset)
+  // void set(type[] array, optional unsigned long offset)
+  v8::Handle<v8::Value> Callback_set(const v8::Arguments& args) {
+    bool ok = true;
+    uint32_t offset = 0;
+    if (args.Length() >= 2) {
+      offset = FromV8<uint32_t>(args[1], &ok);
+      if (!ok)
+        return v8::Undefined();
+    }
+    if (!args[0]->IsObject())
+      return ThrowTypeError();
+
+    v8::Local<v8::Object> object = v8::Local<v8::Object>::Cast(args[0]);
+    uint32_t length = GetTypedArrayLength();
+    TNative* data = GetTypedArrayData();
+
+    // set(TypedArray array, optional unsigned long offset)
+    if (object->HasIndexedPropertiesInExternalArrayData() && !ArrayBuffer::HasInstance(object)) {
+      uint32_t src_length = object->GetIndexedPropertiesExternalArrayDataLength();
+      if (offset > length || src_length > length - offset)
+        return ThrowRangeError("Offset out of range.");
+
+      void* src = object->GetIndexedPropertiesExternalArrayData();
+      v8::ExternalArrayType src_type = object->GetIndexedPropertiesExternalArrayDataType();
+      uint32_t src_size = src_length * ExternalArrayElementSize(src_type);
+      char* dst_begin = reinterpret_cast<char*>(data + offset);
+      char* src_begin = static_cast<char*>(src);
+      // Same types are copied with memmove, different types that share
+      // storage need the source copied aside before converting.
+      if (src_type != TArrayType && src_size > 0 &&
+          src_begin < dst_begin + src_length * sizeof(TNative) && dst_begin < src_begin + src_size) {
+        void* copy = malloc(src_size);
+        if (!copy)
+          return ThrowError("Unable to allocate memory.");
+        memcpy(copy, src, src_size);
+        CopyExternalArrayData<TArrayType>(data + offset, copy, src_type, src_length);
+        free(copy);
+      }
+      else
+        CopyExternalArrayData<TArrayType>(data + offset, src, src_type, src_length);
+    }
+    // set(type[] array, optional unsigned long offset)
+    else {
+      uint32_t src_length = 0;
+      if (object->IsArray())
+        src_length = v8::Local<v8::Array>::Cast(object)->Length();
+      else {
+        src_length = FromV8<uint32_t>(object->Get(ArrayBufferView::length_symbol()), &ok);
+        if (!ok)
+          return v8::Undefined();
+      }
+      if (offset > length || src_length > length - offset)
+        return ThrowRangeError("Offset out of range.");
+
+      for (uint32_t i = 0; i < src_length; i++) {
+        v8::Local<v8::Value> value = object->Get(i);
+        if (value.IsEmpty())
+          return v8::Undefined();
+        data[offset + i] = Converter::FromDouble(value->NumberValue());
+      }
+    }
+    return v8::Undefined();
+  }
+
+  // TypedArray subarray(long begin, optional long end)
+  v8::Handle<v8::Value> Callback_subarray(const v8::Arguments& args) {
+    bool ok = true;
+    uint32_t length = GetTypedArrayLength();
+    int64_t begin_index = FromV8<int32_t>(args[0], &ok);
+    if (!ok)
+      return v8::Undefined();
+    int64_t end_index = length;
+    if (args.Length() >= 2) {
+      end_index = FromV8<int32_t>(args[1], &ok);
+      if (!ok)
+        return v8::Undefined();
+    }
+
+    // Negative indices count from the end, then clamp to the array
+    uint32_t begin = ClampArrayIndex(begin_index, length);
+    uint32_t end = ClampArrayIndex(end_index, length);
+    if (end < begin)
+      end = begin;
+
+    v8::Local<v8::Value> buffer = this->ToV8Object()->GetInternalField(ArrayBufferView::kBufferField);
+
+    v8::Handle<v8::Value> argv[3] = {
+      buffer,
+      ToV8<uint32_t>(byte_offset() + begin * sizeof(TNative)),
+      ToV8<uint32_t>(end - begin)
+    };
+    return V8Object<T>::Create(3, argv);
+  }
 
  private:
   inline static v8::Handle<v8::Value> CheckAlignment(uint32_t val, bool* ok) {
@@ -229,8 +607,10 @@ struct Array {};
    public:                                                              \
    static const char* const ClassName() { return #name; }               \
    protected:                                                           \
-   name(v8::Handle<v8::Object> instance)                                \
-       : TypedArray<name, arraytype, native>(instance) {}               \
+   name(ArrayBuffer* buffer, uint32_t byte_offset, uint32_t byte_length, \
+        v8::Handle<v8::Object> instance)                                \
+       : TypedArray<name, arraytype, native>(buffer, byte_offset,       \
+                                             byte_length, instance) {}  \
    friend class TypedArray<name, arraytype, native>;                    \
   }
 
@@ -256,7 +636,129 @@ DECLARE_TYPED_ARRAY(Float64Array, v8::kExternalDoubleArray, double);
 
 //////
 
-//XXX DataView
+// Byte swapping for DataView, by element size.
+template<size_t N>
+struct ByteSwapper {};
+
+template<>
+struct ByteSwapper<1> {
+  static void Swap(void*) {}
+};
+
+template<>
+struct ByteSwapper<2> {
+  static void Swap(void* data) {
+    uint16_t value;
+    memcpy(&value, data, sizeof(value));
+    value = __builtin_bswap16(value);
+    memcpy(data, &value, sizeof(value));
+  }
+};
+
+template<>
+struct ByteSwapper<4> {
+  static void Swap(void* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    value = __builtin_bswap32(value);
+    memcpy(data, &value, sizeof(value));
+  }
+};
+
+template<>
+struct ByteSwapper<8> {
+  static void Swap(void* data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    value = __builtin_bswap64(value);
+    memcpy(data, &value, sizeof(value));
+  }
+};
+
+class DataView : public V8Object<DataView>, public ArrayDataInterface, public ArrayBufferViewBase {
+ public:
+  static const char* const ClassName() { return "DataView"; }
+  static void ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor);
+  static v8::Handle<v8::Value> ConstructorCallback(const v8::Arguments& args);
+
+  void* GetArrayData() {
+    if (!buffer())
+      return NULL;
+    return static_cast<char*>(buffer()->GetArrayData()) + byte_offset();
+  }
+  uint32_t GetArrayLength() { return byte_length(); }
+
+ protected:
+  DataView(ArrayBuffer* buffer, uint32_t byte_offset, uint32_t byte_length, v8::Handle<v8::Object> instance);
+
+  void Neuter() { NeuterView(); }
+
+ private:
+  static inline bool IsLittleEndianHost() {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return false;
+#else
+    return true;
+#endif
+  }
+
+#define GETTER(name) v8::Handle<v8::Value> Getter_##name(v8::Local<v8::String>, const v8::AccessorInfo&)
+  GETTER(buffer);
+  GETTER(byteOffset);
+  GETTER(byteLength);
+#undef GETTER
+
+  static inline v8::Handle<v8::Value> ElementToV8(int32_t value) { return ToV8(value); }
+  static inline v8::Handle<v8::Value> ElementToV8(uint32_t value) { return ToV8(value); }
+  static inline v8::Handle<v8::Value> ElementToV8(double value) { return ToV8(value); }
+
+  // Returns a pointer to sizeof(TNative) bytes at byte_offset, or NULL if out of range.
+  template<typename TNative>
+  char* ElementData(v8::Handle<v8::Value> value, bool* ok) {
+    uint32_t byte_offset = FromV8<uint32_t>(value, ok);
+    if (!*ok)
+      return NULL;
+    if (byte_length() < sizeof(TNative) || byte_offset > byte_length() - sizeof(TNative)) {
+      *ok = false;
+      ThrowRangeError("Offset out of range.");
+      return NULL;
+    }
+    return static_cast<char*>(GetArrayData()) + byte_offset;
+  }
+
+  // type getType(unsigned long byteOffset, optional boolean littleEndian)
+  template<typename TNative>
+  v8::Handle<v8::Value> Callback_get(const v8::Arguments& args) {
+    bool ok = true;
+    char* data = ElementData<TNative>(args[0], &ok);
+    if (!ok)
+      return v8::Undefined();
+    bool little_endian = args.Length() >= 2 && args[1]->BooleanValue();
+
+    // Unaligned load, swapped if the requested order is not native
+    TNative value;
+    memcpy(&value, data, sizeof(value));
+    if (little_endian != IsLittleEndianHost())
+      ByteSwapper<sizeof(TNative)>::Swap(&value);
+    return ElementToV8(value);
+  }
+
+  // void setType(unsigned long byteOffset, type value, optional boolean littleEndian)
+  template<typename TNative>
+  v8::Handle<v8::Value> Callback_set(const v8::Arguments& args) {
+    bool ok = true;
+    char* data = ElementData<TNative>(args[0], &ok);
+    if (!ok)
+      return v8::Undefined();
+    bool little_endian = args.Length() >= 3 && args[2]->BooleanValue();
+
+    TNative value = ElementConverter<TNative>::FromDouble(args[1]->NumberValue());
+    if (little_endian != IsLittleEndianHost())
+      ByteSwapper<sizeof(TNative)>::Swap(&value);
+    memcpy(data, &value, sizeof(value));
+    return v8::Undefined();
+  }
+};
 
 }
 
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "v8_binding.h"
+#include <stdlib.h>
 
 namespace v8_webgl {
 
@@ -18,12 +19,15 @@ V8ObjectBase::~V8ObjectBase() {
 void V8ObjectBase::SetInstance(v8::Handle<v8::Object> instance, bool weak) {
   instance_ = v8::Persistent<v8::Object>::New(instance);
   instance_->SetPointerInInternalField(0, this);
-  if (weak) {
-    // Since we aren't using object grouping API, mark independent
-    // so our weak callback is called earlier.
-    instance_.MarkIndependent();
-    instance_.MakeWeak(this, WeakCallback);
-  }
+  if (weak)
+    MakeWeak();
+}
+
+void V8ObjectBase::MakeWeak() {
+  // Since we aren't using object grouping API, mark independent
+  // so our weak callback is called earlier.
+  instance_.MarkIndependent();
+  instance_.MakeWeak(this, WeakCallback);
 }
 
 void V8ObjectBase::WeakCallback(v8::Persistent<v8::Value> value, void* data) {
@@ -31,6 +35,14 @@ void V8ObjectBase::WeakCallback(v8::Persistent<v8::Value> value, void* data) {
   delete object;
 }
 
+int V8ObjectBase::AllocateClassIndex() {
+  static int s_class_count = 0;
+  int index = __sync_fetch_and_add(&s_class_count, 1);
+  if (index >= Runtime::kMaxClasses)
+    abort();
+  return index;
+}
+
 v8::Persistent<v8::FunctionTemplate> V8ObjectBase::CreateConstructorTemplate(const char* class_name, v8::InvocationCallback callback) {
   v8::Local<v8::FunctionTemplate> result = v8::FunctionTemplate::New(callback);
   v8::Persistent<v8::FunctionTemplate> constructor = v8::Persistent<v8::FunctionTemplate>::New(result);
@@ -7,6 +7,7 @@
 
 #include <v8.h>
 #include "converters.h"
+#include "runtime.h"
 
 namespace v8_webgl {
 
@@ -107,8 +108,12 @@ class V8ObjectBase {
   }
 
   static v8::Persistent<v8::FunctionTemplate> CreateConstructorTemplate(const char* class_name, v8::InvocationCallback callback);
+  // Process wide index of each V8Object class into Runtime::ClassData.
+  static int AllocateClassIndex();
 
   void SetInstance(v8::Handle<v8::Object> instance, bool weak = false);
+  // Let the GC delete this object once its instance is unreachable.
+  void MakeWeak();
 
  private:
   V8ObjectBase(const V8ObjectBase&);
@@ -122,16 +127,7 @@ class V8ObjectBase {
 //////
 
 template<class T>
-class ConstructorMode {
- public:
-  ConstructorMode() { s_allow_construction = true; }
-  ~ConstructorMode() { s_allow_construction = false; }
-  static bool IsConstructionAllowed() { return s_allow_construction; }
- private:
-  static bool s_allow_construction;
-};
-template<class T>
-bool ConstructorMode<T>::s_allow_construction = false;
+class ConstructorMode;
 
 //////
 
@@ -139,20 +135,25 @@ template<class T>
 class V8Object : public V8ObjectBase {
  public:
   static void Initialize(v8::Handle<v8::ObjectTemplate> global) {
-    if (!s_constructor_template.IsEmpty())
+    Runtime::ClassData& data = class_data();
+    if (!data.constructor_template.IsEmpty())
       return;
     v8::HandleScope scope;
-    s_constructor_template =
+    data.constructor_template =
         CreateConstructorTemplate(T::ClassName(), InvocationCallbackCatcher<T::ConstructorCallback>);
-    T::ConfigureConstructorTemplate(s_constructor_template);
+    T::ConfigureConstructorTemplate(data.constructor_template);
     T::ConfigureGlobal(global);
+    data.instance_template = v8::Persistent<v8::ObjectTemplate>::New(data.constructor_template->InstanceTemplate());
   }
 
   static void Uninitialize() {
-    if (s_constructor_template.IsEmpty())
+    Runtime::ClassData& data = class_data();
+    if (data.constructor_template.IsEmpty())
       return;
-    s_constructor_template.Dispose();
-    s_constructor_template.Clear();
+    data.instance_template.Dispose();
+    data.instance_template.Clear();
+    data.constructor_template.Dispose();
+    data.constructor_template.Clear();
   }
 
   inline static T* FromV8Object(v8::Handle<v8::Object> value) {
@@ -160,11 +161,21 @@ class V8Object : public V8ObjectBase {
   }
 
   inline static bool HasInstance(v8::Handle<v8::Value> value){
-    return s_constructor_template->HasInstance(value);
+    return class_data().constructor_template->HasInstance(value);
   }
 
   inline static void Reparent(v8::Handle<v8::FunctionTemplate> child) {
-    child->Inherit(s_constructor_template);
+    child->Inherit(class_data().constructor_template);
+  }
+
+  static int class_index() {
+    static int index = AllocateClassIndex();
+    return index;
+  }
+
+  // State of this class in the current isolate
+  inline static Runtime::ClassData& class_data() {
+    return Runtime::Current()->class_data(class_index());
   }
 
  protected:
@@ -178,7 +189,13 @@ class V8Object : public V8ObjectBase {
   }
 
   static v8::Handle<v8::Object> Create(int argc = 0, v8::Handle<v8::Value> argv[] = NULL) {
-    return s_constructor_template->GetFunction()->NewInstance(argc, argv);
+    return class_data().constructor_template->GetFunction()->NewInstance(argc, argv);
+  }
+
+  // Faster than Create for objects only constructed natively,
+  // instantiates the instance template without calling the constructor.
+  static v8::Handle<v8::Object> NewInstance() {
+    return class_data().instance_template->NewInstance();
   }
 
   // Subclasses should reimplement
@@ -186,7 +203,7 @@ class V8Object : public V8ObjectBase {
 
   // Subclasses can reimplement this if they don't want their constructor name exposed
   static void ConfigureGlobal(v8::Handle<v8::ObjectTemplate> global) {
-    global->Set(v8::String::New(T::ClassName()), s_constructor_template);
+    global->Set(v8::String::New(T::ClassName()), class_data().constructor_template);
   }
 
   static v8::Handle<v8::Value> ConstructorCallback(const v8::Arguments& args) {
@@ -195,13 +212,17 @@ class V8Object : public V8ObjectBase {
 
     return args.This();
   }
-
- private:
-  static v8::Persistent<v8::FunctionTemplate> s_constructor_template;
 };
 
+//////
+
 template<class T>
-v8::Persistent<v8::FunctionTemplate> V8Object<T>::s_constructor_template;
+class ConstructorMode {
+ public:
+  ConstructorMode() { V8Object<T>::class_data().allow_construction = true; }
+  ~ConstructorMode() { V8Object<T>::class_data().allow_construction = false; }
+  static bool IsConstructionAllowed() { return V8Object<T>::class_data().allow_construction; }
+};
 
 }
 
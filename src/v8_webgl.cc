@@ -5,6 +5,9 @@
 #include <v8_webgl.h>
 #include "canvas.h"
 #include "console.h"
+#include "effect_chain.h"
+#include "pool_allocator.h"
+#include "runtime.h"
 #include "typed_array.h"
 #include "webgl_active_info.h"
 #include "webgl_buffer.h"
@@ -18,55 +21,46 @@
 
 namespace v8_webgl {
 
-static Factory* s_factory = NULL;
-static v8::Persistent<v8::ObjectTemplate> s_global;
-
 v8::Persistent<v8::ObjectTemplate> Initialize(Factory* factory) {
-  if (!s_global.IsEmpty())
-    return s_global;
-
-  s_factory = factory;
-
-  v8::HandleScope scope;
-  v8::Local<v8::ObjectTemplate> global = v8::ObjectTemplate::New();
-  s_global = v8::Persistent<v8::ObjectTemplate>::New(global);
-
-  Console::Initialize(s_global);
-  Canvas::Initialize(s_global);
-  WebGLActiveInfo::Initialize(s_global);
-  WebGLBuffer::Initialize(s_global);
-  WebGLFramebuffer::Initialize(s_global);
-  WebGLProgram::Initialize(s_global);
-  WebGLRenderbuffer::Initialize(s_global);
-  WebGLRenderingContext::Initialize(s_global);
-  WebGLShader::Initialize(s_global);
-  WebGLTexture::Initialize(s_global);
-  WebGLUniformLocation::Initialize(s_global);
+  Runtime* runtime = Runtime::Current();
+  if (runtime)
+    return runtime->global();
+
+  runtime = Runtime::New(factory);
+  v8::Persistent<v8::ObjectTemplate> global = runtime->global();
+
+  Console::Initialize(global);
+  Canvas::Initialize(global);
+  WebGLActiveInfo::Initialize(global);
+  WebGLBuffer::Initialize(global);
+  WebGLFramebuffer::Initialize(global);
+  WebGLProgram::Initialize(global);
+  WebGLRenderbuffer::Initialize(global);
+  WebGLRenderingContext::Initialize(global);
+  WebGLShader::Initialize(global);
+  WebGLTexture::Initialize(global);
+  WebGLUniformLocation::Initialize(global);
 
   // Typed Array
-  ArrayBuffer::Initialize(s_global);
-  ArrayBufferView::Initialize(s_global);
-  Int8Array::Initialize(s_global);
-  Uint8Array::Initialize(s_global);
-  Uint8ClampedArray::Initialize(s_global);
-  Int16Array::Initialize(s_global);
-  Uint16Array::Initialize(s_global);
-  Int32Array::Initialize(s_global);
-  Uint32Array::Initialize(s_global);
-  Float32Array::Initialize(s_global);
-  Float64Array::Initialize(s_global);
-
-  return s_global;
-}
-
-void Uninitialize() {
-  if (s_global.IsEmpty())
-    return;
-  s_global.Dispose();
-  s_global.Clear();
+  ArrayBuffer::Initialize(global);
+  ArrayBufferView::Initialize(global);
+  Int8Array::Initialize(global);
+  Uint8Array::Initialize(global);
+  Uint8ClampedArray::Initialize(global);
+  Int16Array::Initialize(global);
+  Uint16Array::Initialize(global);
+  Int32Array::Initialize(global);
+  Uint32Array::Initialize(global);
+  Float32Array::Initialize(global);
+  Float64Array::Initialize(global);
+  DataView::Initialize(global);
 
-  delete s_factory;
-  s_factory = NULL;
+  return global;
+}
+
+void Uninitialize(bool dispose_v8) {
+  if (!Runtime::Current())
+    return;
 
   Console::Uninitialize();
   Canvas::Uninitialize();
@@ -92,16 +86,174 @@ void Uninitialize() {
   Uint32Array::Uninitialize();
   Float32Array::Uninitialize();
   Float64Array::Uninitialize();
+  DataView::Uninitialize();
 
-  // Run GC until everything is freed
-  //XXX this isn't triggering weak callbacks. may need to expose dispose() method on canvas and have app cleanup explicitly? would need to explicitly delete the native ptr, and zero out the internal - and make methods deal with that
+  // Run GC until everything is freed.
+  // Weak callbacks are not guaranteed to run here, so GL resources are only
+  // released deterministically if scripts dispose() their canvases.
   while (!v8::V8::IdleNotification()) {}
 
-  v8::V8::Dispose();
+  Runtime::Current()->FlushExternalMemory();
+  // Only the calling thread's pool, other pools are freed at thread exit
+  PoolAllocator::Trim();
+  WebGLActiveInfo::Trim();
+  WebGLUniformLocation::Trim();
+
+  // Weak callbacks above may still use the factory
+  Runtime::Delete();
+
+  if (dispose_v8)
+    v8::V8::Dispose();
+}
+
+void PrewarmGraphicContexts(int count, int width, int height) {
+  Runtime* runtime = Runtime::Current();
+  runtime->PrewarmGraphicContexts(count, width, height);
+  if (count > 0 && !runtime->shader_resources()) {
+    // Last prewarmed context is still current
+    ShBuiltInResources resources;
+    ShaderCompiler::GetResources(&resources);
+  }
+}
+
+ContextLock::ContextLock(v8::Isolate* isolate)
+    : isolate_(isolate)
+    , locker_(isolate) {}
+
+ContextLock::~ContextLock() {
+  // Runs before locker_ unlocks
+  Runtime* runtime = Runtime::From(isolate_);
+  if (runtime)
+    runtime->ReleaseCurrentContext();
+}
+
+void ReleaseCurrentContext() {
+  Runtime* runtime = Runtime::Current();
+  if (runtime)
+    runtime->ReleaseCurrentContext();
+}
+
+bool PrecompilePrograms(v8::Handle<v8::Object> context,
+                        const std::vector<ProgramSource>& sources,
+                        std::vector<ProgramTimings>* timings) {
+  if (!WebGLRenderingContext::HasInstance(context))
+    return false;
+  WebGLRenderingContext* rendering_context = WebGLRenderingContext::FromV8Object(context);
+  if (!rendering_context || rendering_context->is_disposed())
+    return false;
+  rendering_context->MakeCurrent();
+  rendering_context->PrecompilePrograms(sources, timings);
+  return true;
+}
+
+bool GetMemoryInfo(v8::Handle<v8::Object> context, MemoryInfo* info) {
+  if (!WebGLRenderingContext::HasInstance(context))
+    return false;
+  WebGLRenderingContext* rendering_context = WebGLRenderingContext::FromV8Object(context);
+  if (!rendering_context)
+    return false;
+  *info = rendering_context->memory_info();
+  return true;
+}
+
+bool FlushDeleteQueue(v8::Handle<v8::Object> context) {
+  if (!WebGLRenderingContext::HasInstance(context))
+    return false;
+  WebGLRenderingContext* rendering_context = WebGLRenderingContext::FromV8Object(context);
+  if (!rendering_context)
+    return false;
+  rendering_context->FlushDeleteQueue();
+  return true;
+}
+
+bool GetShaderStats(v8::Handle<v8::Object> context, ShaderStats* stats) {
+  if (!WebGLRenderingContext::HasInstance(context))
+    return false;
+  WebGLRenderingContext* rendering_context = WebGLRenderingContext::FromV8Object(context);
+  if (!rendering_context)
+    return false;
+  *stats = rendering_context->shader_stats();
+  return true;
+}
+
+EffectChain* CreateEffectChain(v8::Handle<v8::Object> context, int width, int height) {
+  if (!WebGLRenderingContext::HasInstance(context))
+    return 0;
+  return new EffectChainImpl(context, width, height);
+}
+
+v8::Handle<v8::Object> CreateExternalArrayBuffer(void* data, uint32_t length,
+                                                 ArrayBufferReleaseCallback release,
+                                                 void* user_data) {
+  return ArrayBuffer::CreateExternal(data, length, release, user_data);
+}
+
+v8::Handle<v8::Object> CreateExternalTypedArray(ArrayType type, void* data, uint32_t length,
+                                                ArrayBufferReleaseCallback release,
+                                                void* user_data) {
+  uint32_t element_size = 1;
+  switch (type) {
+    case kInt16Array:
+    case kUint16Array:
+      element_size = 2;
+      break;
+    case kInt32Array:
+    case kUint32Array:
+    case kFloat32Array:
+      element_size = 4;
+      break;
+    case kFloat64Array:
+      element_size = 8;
+      break;
+    default:
+      break;
+  }
+  if (reinterpret_cast<uintptr_t>(data) & (element_size - 1) || length > 0xffffffffu / element_size)
+    return v8::Handle<v8::Object>();
+
+  v8::Handle<v8::Object> buffer = ArrayBuffer::CreateExternal(data, length * element_size, release, user_data);
+  if (buffer.IsEmpty())
+    return buffer;
+
+  switch (type) {
+    case kInt8Array:
+      return Int8Array::Create(buffer, 0, length);
+    case kUint8Array:
+      return Uint8Array::Create(buffer, 0, length);
+    case kUint8ClampedArray:
+      return Uint8ClampedArray::Create(buffer, 0, length);
+    case kInt16Array:
+      return Int16Array::Create(buffer, 0, length);
+    case kUint16Array:
+      return Uint16Array::Create(buffer, 0, length);
+    case kInt32Array:
+      return Int32Array::Create(buffer, 0, length);
+    case kUint32Array:
+      return Uint32Array::Create(buffer, 0, length);
+    case kFloat32Array:
+      return Float32Array::Create(buffer, 0, length);
+    case kFloat64Array:
+      return Float64Array::Create(buffer, 0, length);
+  }
+  return v8::Handle<v8::Object>();
+}
+
+v8::Handle<v8::Object> CreateMappedArrayBuffer(const char* path, bool read_only) {
+  return ArrayBuffer::CreateMapped(path, read_only);
+}
+
+bool DetachArrayBuffer(v8::Handle<v8::Object> buffer) {
+  if (!ArrayBuffer::HasInstance(buffer))
+    return false;
+  ArrayBuffer* array_buffer = ArrayBuffer::FromV8Object(buffer);
+  if (!array_buffer)
+    return false;
+  array_buffer->Detach();
+  return true;
 }
 
 Factory* GetFactory() {
-  return s_factory;
+  return Runtime::Current()->factory();
 }
 
 }
@@ -7,13 +7,36 @@
 namespace v8_webgl {
 
 WebGLActiveInfo::WebGLActiveInfo(GLint size, GLenum type, const char* name)
-    : V8Object<WebGLActiveInfo>(true) {
-  v8::Handle<v8::Object> instance(ToV8Object());
-  v8::PropertyAttribute attrs = static_cast<v8::PropertyAttribute>(v8::ReadOnly|v8::DontDelete);
-  instance->Set(ToV8("size"), ToV8(size), attrs);
-  instance->Set(ToV8("type"), ToV8(type), attrs);
-  instance->Set(ToV8("name"), ToV8(name), attrs);
+    : V8Object<WebGLActiveInfo>(true, NewInstance())
+    , size_(size)
+    , type_(type)
+    , name_(name) {
 }
 
+v8::Handle<v8::Value> WebGLActiveInfo::Getter_size(v8::Local<v8::String> property, const v8::AccessorInfo& info) {
+  return ToV8(size_);
+}
+
+v8::Handle<v8::Value> WebGLActiveInfo::Getter_type(v8::Local<v8::String> property, const v8::AccessorInfo& info) {
+  return ToV8(type_);
+}
+
+v8::Handle<v8::Value> WebGLActiveInfo::Getter_name(v8::Local<v8::String> property, const v8::AccessorInfo& info) {
+  return ToV8(name_);
+}
+
+void WebGLActiveInfo::ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor) {
+  v8::Handle<v8::ObjectTemplate> instance = constructor->InstanceTemplate();
+
+  // Read only accessors on the instance template, instead of setting
+  // properties on every new instance.
+#define ACCESSOR(name) SetAccessor(instance, #name, AccessorGetterDispatcher<WebGLActiveInfo, &WebGLActiveInfo::Getter_##name>, 0)
+
+  ACCESSOR(size);
+  ACCESSOR(type);
+  ACCESSOR(name);
+
+#undef ACCESSOR
+}
 
 }
@@ -5,19 +5,33 @@
 #ifndef V8WEBGL_WEBGL_ACTIVE_INFO_H
 #define V8WEBGL_WEBGL_ACTIVE_INFO_H
 
+#include "object_pool.h"
 #include "v8_binding.h"
 #include "webgl_rendering_context.h"
+#include <string>
 
 namespace v8_webgl {
 
-class WebGLActiveInfo : public V8Object<WebGLActiveInfo> {
+class WebGLActiveInfo : public V8Object<WebGLActiveInfo>, public PooledObject<WebGLActiveInfo> {
  public:
   static const char* const ClassName() { return "WebGLActiveInfo"; }
+  static void ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor);
 
  protected:
   WebGLActiveInfo(GLint size, GLenum type, const char* name);
 
   friend class WebGLRenderingContext;
+
+ private:
+  GLint size_;
+  GLenum type_;
+  std::string name_;
+
+#define GETTER(name) v8::Handle<v8::Value> Getter_##name(v8::Local<v8::String>, const v8::AccessorInfo&)
+  GETTER(size);
+  GETTER(type);
+  GETTER(name);
+#undef GETTER
 };
 
 }
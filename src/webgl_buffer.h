@@ -13,12 +13,21 @@ namespace v8_webgl {
 class WebGLBuffer : public WebGLObject<WebGLBuffer, GLuint> {
  public:
   static const char* const ClassName() { return "WebGLBuffer"; }
+  enum { kShareable = 1 };
+
+  // Bytes allocated by bufferData.
+  size_t memory_size() { return memory_size_; }
+  void set_memory_size(size_t memory_size) { memory_size_ = memory_size; }
 
  protected:
   WebGLBuffer(WebGLRenderingContext* context, GLuint buffer_id)
-      : WebGLObject<WebGLBuffer, GLuint>(context, buffer_id) {}
+      : WebGLObject<WebGLBuffer, GLuint>(context, buffer_id)
+      , memory_size_(0) {}
 
   friend class WebGLRenderingContext;
+
+ private:
+  size_t memory_size_;
 };
 
 }
@@ -10,10 +10,31 @@
 
 namespace v8_webgl {
 
+// Objects record their owner as the context or ShareGroup id plus one,
+// a deleted object has owner 0. Deleted objects are never revived, a
+// reused GL name gets a new object, so stale wrappers keep failing.
+inline uint32_t MakeObjectOwner(unsigned long owner_id) {
+  return static_cast<uint32_t>(owner_id + 1);
+}
+
 class WebGLObjectInterface {
  public:
   virtual ~WebGLObjectInterface() {}
-  virtual bool ValidateContext(WebGLRenderingContext* context) = 0;
+
+  // Fails for deleted objects and objects of other contexts,
+  // except shareable objects of the context's ShareGroup.
+  bool ValidateContext(WebGLRenderingContext* context) {
+    return owner_ == MakeObjectOwner(context->get_context_id()) ||
+        owner_ == MakeObjectOwner(context->get_share_group_id());
+  }
+  bool is_deleted() { return owner_ == 0; }
+
+ protected:
+  // owner_id is a context id, or a ShareGroup id for shareable objects.
+  WebGLObjectInterface(unsigned long owner_id)
+      : owner_(MakeObjectOwner(owner_id)) {}
+
+  uint32_t owner_;
 };
 
 //////
@@ -21,17 +42,60 @@ class WebGLObjectInterface {
 template<class V, typename T>
 class WebGLObject : public V8Object<V>, public WebGLObjectInterface {
  public:
-  WebGLObject(WebGLRenderingContext* context, T webgl_id, bool weak = false)
-      : V8Object<V>(weak)
-      , context_id_(context->get_context_id())
-      , webgl_id_(webgl_id) {}
+  // Subclasses set this to 1 if their GL objects are shared by a ShareGroup.
+  enum { kShareable = 0 };
+
+  WebGLObject(WebGLRenderingContext* context, T webgl_id, bool weak = false,
+              v8::Handle<v8::Object> instance = v8::Local<v8::Object>())
+      : V8Object<V>(weak, instance)
+      , WebGLObjectInterface(V::kShareable ? context->get_share_group_id() : context->get_context_id())
+      , context_(context)
+      , webgl_id_(webgl_id)
+      , has_been_bound_(false) {}
 
-  bool ValidateContext(WebGLRenderingContext* context) { return context->get_context_id() == context_id_; }
   T webgl_id() { return webgl_id_; }
 
+  // Set by bind* calls. Names that were never bound have no GL object yet.
+  bool has_been_bound() { return has_been_bound_; }
+  void set_has_been_bound() { has_been_bound_ = true; }
+
+  static void ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor) {
+    v8::Local<v8::Signature> signature = v8::Signature::New(constructor);
+    V8ObjectBase::AddCallback(constructor->PrototypeTemplate(), "dispose", InvocationCallbackCatcher<Callback_dispose>, signature);
+  }
+
  private:
-  unsigned long context_id_;
+  // Not part of WebGL.
+  // void dispose();
+  // Deletes the GL object the next time the context is made current,
+  // and the native object now. Further use of the instance throws.
+  static v8::Handle<v8::Value> Callback_dispose(const v8::Arguments& args) {
+    V* object = V::FromV8Object(args.Holder());
+    if (!object)
+      return ThrowObjectDisposed();
+    // Deleted objects no longer own a GL object
+    if (object->is_deleted())
+      delete object;
+    else
+      object->context_->DisposeObject(object);
+    return v8::Undefined();
+  }
+
+  // The native object outlives deletion so stale wrappers fail validation,
+  // it is deleted once the wrapper is collected.
+  void Invalidate() {
+    owner_ = 0;
+    this->MakeWeak();
+  }
+
+  // Only valid while the object is not deleted, deleting a context
+  // deletes or invalidates all of its objects. Shared objects are handed
+  // to another context of the ShareGroup instead.
+  WebGLRenderingContext* context_;
   T webgl_id_;
+  bool has_been_bound_;
+
+  friend class WebGLRenderingContext;
 };
 
 }
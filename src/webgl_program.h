@@ -7,6 +7,11 @@
 
 #include "webgl_object.h"
 #include "webgl_rendering_context.h"
+#include "shader_specialization.h"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace v8_webgl {
 
@@ -14,11 +19,69 @@ class WebGLProgram : public WebGLObject<WebGLProgram, GLuint> {
  public:
   static const char* const ClassName() { return "WebGLProgram"; }
 
+  bool link_status() { return link_status_; }
+  void set_link_status(bool link_status) { link_status_ = link_status; }
+
+  // True if the active variables below were merged from translator
+  // reflection data at the last successful link.
+  bool has_variables() { return has_variables_; }
+  void set_has_variables(bool has_variables) { has_variables_ = has_variables; }
+
+  ShaderVariableList& active_attributes() { return active_attributes_; }
+  ShaderVariableList& active_uniforms() { return active_uniforms_; }
+
+  const ShaderVariable* FindActiveUniform(const std::string& name) {
+    for (size_t i = 0; i < active_uniforms_.size(); i++) {
+      if (active_uniforms_[i].name == name)
+        return &active_uniforms_[i];
+    }
+    return 0;
+  }
+
+  // Program compiled with specialization constants baked in.
+  struct Variant {
+    Variant() : program_id(0) {}
+    GLuint program_id;
+    // Base program uniform location to variant location
+    std::map<GLint, GLint> uniform_locations;
+  };
+  typedef std::map<std::string, Variant> VariantMap;
+  typedef std::vector<std::pair<std::string, GLint> > AttributeLocations;
+
+  SpecializationConstants& specialization_constants() { return specialization_constants_; }
+  VariantMap& variants() { return variants_; }
+
+  // Sources and attribute locations of the last successful link,
+  // used to build variants.
+  std::string& linked_vertex_source() { return linked_vertex_source_; }
+  std::string& linked_fragment_source() { return linked_fragment_source_; }
+  AttributeLocations& linked_attribute_locations() { return linked_attribute_locations_; }
+
+  // GL program holding the latest uniform values, the base program or
+  // the variant last used. Values are copied over when switching variants.
+  GLuint uniform_values_id() { return uniform_values_id_; }
+  void set_uniform_values_id(GLuint program_id) { uniform_values_id_ = program_id; }
+
  protected:
   WebGLProgram(WebGLRenderingContext* context, GLuint program_id)
-      : WebGLObject<WebGLProgram, GLuint>(context, program_id) {}
+      : WebGLObject<WebGLProgram, GLuint>(context, program_id)
+      , link_status_(false)
+      , has_variables_(false)
+      , uniform_values_id_(program_id) {}
 
   friend class WebGLRenderingContext;
+
+ private:
+  bool link_status_;
+  bool has_variables_;
+  ShaderVariableList active_attributes_;
+  ShaderVariableList active_uniforms_;
+  SpecializationConstants specialization_constants_;
+  VariantMap variants_;
+  std::string linked_vertex_source_;
+  std::string linked_fragment_source_;
+  AttributeLocations linked_attribute_locations_;
+  GLuint uniform_values_id_;
 };
 
 }
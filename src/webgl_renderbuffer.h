@@ -14,11 +14,19 @@ class WebGLRenderbuffer : public WebGLObject<WebGLRenderbuffer, GLuint> {
  public:
   static const char* const ClassName() { return "WebGLRenderbuffer"; }
 
+  // Bytes allocated by renderbufferStorage.
+  size_t memory_size() { return memory_size_; }
+  void set_memory_size(size_t memory_size) { memory_size_ = memory_size; }
+
  protected:
   WebGLRenderbuffer(WebGLRenderingContext* context, GLuint renderbuffer_id)
-      : WebGLObject<WebGLRenderbuffer, GLuint>(context, renderbuffer_id) {}
+      : WebGLObject<WebGLRenderbuffer, GLuint>(context, renderbuffer_id)
+      , memory_size_(0) {}
 
   friend class WebGLRenderingContext;
+
+ private:
+  size_t memory_size_;
 };
 
 }
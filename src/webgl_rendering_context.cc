@@ -4,6 +4,7 @@
 
 #include "v8_webgl_internal.h"
 #include "v8_binding.h"
+#include "share_group.h"
 #include "typed_array.h"
 #include "webgl_active_info.h"
 #include "webgl_buffer.h"
@@ -14,37 +15,328 @@
 #include "webgl_shader.h"
 #include "webgl_texture.h"
 #include "webgl_uniform_location.h"
+#include "timer.h"
 
+#include <algorithm>
+#include <sstream>
 #include <string>
 #include <stdarg.h>
 
 namespace v8_webgl {
 
-unsigned long WebGLRenderingContext::s_context_counter = 0;
-
-
-WebGLRenderingContext::WebGLRenderingContext(int width, int height)
+WebGLRenderingContext::WebGLRenderingContext(int width, int height, const ContextAttributes& attributes)
     : V8Object<WebGLRenderingContext>()
-    , graphic_context_(GetFactory()->CreateGraphicContext(width, height))
-    , context_id_(s_context_counter++)
-    , gl_error_(GL_NONE) {
-  shader_compiler_.Init(this);
+    , graphic_context_(0)
+    , context_id_(Runtime::Current()->NextContextId())
+    , share_group_(Runtime::Current()->JoinShareGroup(attributes.share_group, this))
+    , share_group_id_(share_group_->id())
+    , shared_(!attributes.share_group.empty())
+    , gl_error_(GL_NONE)
+    , default_framebuffer_(0)
+    , buffer_table_(share_group_->buffer_table())
+    , texture_table_(share_group_->texture_table()) {
+  const std::vector<WebGLRenderingContext*>& group_contexts = share_group_->contexts();
+  if (group_contexts.size() > 1)
+    graphic_context_ = GetFactory()->CreateSharedGraphicContext(width, height, group_contexts[0]->graphic_context_);
+  else
+    graphic_context_ = Runtime::Current()->LeaseGraphicContext(width, height);
+
+  // The factory may or may not have made the new context current, either
+  // way the current context cache must name this one before any GL call.
+  MakeCurrent();
+
+  shader_compiler_.Init(this, attributes.trusted_shaders);
 
   // https://bugs.webkit.org/show_bug.cgi?id=61945
   glEnable(GL_POINT_SPRITE);
   glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
   glClearColor(0, 0, 0, 0);
+  // Pooled contexts may have been used at another size
+  glViewport(0, 0, width, height);
+  glScissor(0, 0, width, height);
 }
 
 WebGLRenderingContext::~WebGLRenderingContext() {
-  DeleteMapObjects(buffer_map_);
-  DeleteMapObjects(framebuffer_map_);
-  DeleteMapObjects(program_map_);
-  DeleteMapObjects(renderbuffer_map_);
-  DeleteMapObjects(shader_map_);
-  DeleteMapObjects(texture_map_);
+  Dispose();
+}
 
-  delete graphic_context_;
+void WebGLRenderingContext::Dispose() {
+  if (is_disposed())
+    return;
+
+  std::vector<WebGLProgram*> programs;
+  program_table_.GetObjects(&programs);
+  for (size_t i = 0; i < programs.size(); i++)
+    DeleteProgramVariants(programs[i], true);
+
+  Runtime* runtime = Runtime::Current();
+  const std::vector<WebGLRenderingContext*>& group_contexts = share_group_->contexts();
+  if (group_contexts.size() > 1) {
+    // Shared objects live on in the other contexts of the group
+    WebGLRenderingContext* heir = group_contexts[0] != this ? group_contexts[0] : group_contexts[1];
+    HandOverObjects(buffer_table_, &MemoryInfo::buffer_bytes, heir);
+    HandOverObjects(texture_table_, &MemoryInfo::texture_bytes, heir);
+  } else {
+    DisposeObjects(buffer_table_, &delete_queue_.buffers);
+    DisposeObjects(texture_table_, &delete_queue_.textures);
+  }
+  runtime->LeaveShareGroup(share_group_, this);
+  share_group_ = 0;
+
+  DisposeObjects(framebuffer_table_, &delete_queue_.framebuffers);
+  DisposeObjects(program_table_, &delete_queue_.programs);
+  DisposeObjects(renderbuffer_table_, &delete_queue_.renderbuffers);
+  DisposeObjects(shader_table_, &delete_queue_.shaders);
+
+  // Pooled names are reserved until deleted
+  delete_queue_.buffers.insert(delete_queue_.buffers.end(), name_pool_.buffers.begin(), name_pool_.buffers.end());
+  delete_queue_.framebuffers.insert(delete_queue_.framebuffers.end(), name_pool_.framebuffers.begin(), name_pool_.framebuffers.end());
+  delete_queue_.renderbuffers.insert(delete_queue_.renderbuffers.end(), name_pool_.renderbuffers.begin(), name_pool_.renderbuffers.end());
+  delete_queue_.textures.insert(delete_queue_.textures.end(), name_pool_.textures.begin(), name_pool_.textures.end());
+  name_pool_ = NamePool();
+  delete_queue_.pending = true;
+
+  runtime->AdjustExternalMemory(-static_cast<intptr_t>(memory_info_.total_bytes()));
+  memory_info_ = MemoryInfo();
+
+  // May be called from a weak callback, with another context current
+  MakeCurrent();
+
+  // Shared contexts are not pooled, other contexts could still see
+  // objects created in them
+  if (shared_)
+    delete graphic_context_;
+  else {
+    if (runtime->CanPoolGraphicContext())
+      ResetGLState();
+    runtime->ReleaseGraphicContext(graphic_context_);
+  }
+  graphic_context_ = 0;
+  if (runtime->current_context() == this)
+    runtime->set_current_context(0);
+}
+
+void WebGLRenderingContext::ResetGLState() {
+  const ShBuiltInResources* resources = Runtime::Current()->shader_resources();
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glUseProgram(0);
+  for (int i = 0; i < resources->MaxCombinedTextureImageUnits; i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  for (int i = 0; i < resources->MaxVertexAttribs; i++) {
+    glDisableVertexAttribArray(i);
+    glVertexAttrib4f(i, 0, 0, 0, 1);
+  }
+
+  // GL_POINT_SPRITE and GL_VERTEX_PROGRAM_POINT_SIZE are not WebGL
+  // capabilities, scripts can't disable them and the constructor enables
+  // them again. It also sets the viewport and scissor box for the new size.
+  glDisable(GL_BLEND);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_DITHER);
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+  glDisable(GL_SAMPLE_COVERAGE);
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_STENCIL_TEST);
+
+  glBlendColor(0, 0, 0, 0);
+  glBlendEquation(GL_FUNC_ADD);
+  glBlendFunc(GL_ONE, GL_ZERO);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glCullFace(GL_BACK);
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+  glDepthRange(0, 1);
+  glFrontFace(GL_CCW);
+  glHint(GL_GENERATE_MIPMAP_HINT, GL_DONT_CARE);
+  glLineWidth(1);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPolygonOffset(0, 0);
+  glSampleCoverage(1, GL_FALSE);
+  glStencilFunc(GL_ALWAYS, 0, 0xffffffff);
+  glStencilMask(0xffffffff);
+  glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+  // Leave no content behind for the next lease
+  glClearColor(0, 0, 0, 0);
+  glClearDepth(1);
+  glClearStencil(0);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+GLuint WebGLRenderingContext::TakeName(std::vector<GLuint>* pool, GenNamesFunction gen_names) {
+  if (pool->empty()) {
+    pool->resize(kNameBlockSize);
+    gen_names(kNameBlockSize, &(*pool)[0]);
+    // Hand out the lowest names first, keeping ObjectTables dense
+    std::reverse(pool->begin(), pool->end());
+  }
+  GLuint name = pool->back();
+  pool->pop_back();
+  return name;
+}
+
+void WebGLRenderingContext::DrainDeleteQueue() {
+  delete_queue_.pending = false;
+
+  if (!delete_queue_.buffers.empty())
+    glDeleteBuffers(delete_queue_.buffers.size(), &delete_queue_.buffers[0]);
+  if (!delete_queue_.framebuffers.empty())
+    glDeleteFramebuffers(delete_queue_.framebuffers.size(), &delete_queue_.framebuffers[0]);
+  if (!delete_queue_.renderbuffers.empty())
+    glDeleteRenderbuffers(delete_queue_.renderbuffers.size(), &delete_queue_.renderbuffers[0]);
+  if (!delete_queue_.textures.empty())
+    glDeleteTextures(delete_queue_.textures.size(), &delete_queue_.textures[0]);
+  // No batched entry points for these
+  for (size_t i = 0; i < delete_queue_.programs.size(); i++)
+    glDeleteProgram(delete_queue_.programs[i]);
+  for (size_t i = 0; i < delete_queue_.shaders.size(); i++)
+    glDeleteShader(delete_queue_.shaders[i]);
+
+  delete_queue_.buffers.clear();
+  delete_queue_.framebuffers.clear();
+  delete_queue_.programs.clear();
+  delete_queue_.renderbuffers.clear();
+  delete_queue_.shaders.clear();
+  delete_queue_.textures.clear();
+}
+
+template<class T>
+T* WebGLRenderingContext::InsertObject(ObjectTable<T>& table, T* object) {
+  table.Insert(object->webgl_id(), object);
+  return object;
+}
+
+template<class T>
+void WebGLRenderingContext::RemoveObject(ObjectTable<T>& table, T* object) {
+  table.Remove(object->webgl_id());
+  object->Invalidate();
+}
+
+template<class T>
+void WebGLRenderingContext::DisposeObject(ObjectTable<T>& table, std::vector<GLuint>* names, T* object) {
+  names->push_back(object->webgl_id());
+  delete_queue_.pending = true;
+  table.Remove(object->webgl_id());
+  delete object;
+}
+
+template<class T>
+void WebGLRenderingContext::DisposeObjects(ObjectTable<T>& table, std::vector<GLuint>* names) {
+  std::vector<T*> objects;
+  table.GetObjects(&objects);
+  for (size_t i = 0; i < objects.size(); i++)
+    names->push_back(objects[i]->webgl_id());
+  if (!objects.empty())
+    delete_queue_.pending = true;
+  table.DeleteAll();
+}
+
+template<class T>
+void WebGLRenderingContext::HandOverObjects(ObjectTable<T>& table, size_t MemoryInfo::*field, WebGLRenderingContext* heir) {
+  std::vector<T*> objects;
+  table.GetObjects(&objects);
+  for (size_t i = 0; i < objects.size(); i++) {
+    T* object = objects[i];
+    if (object->context_ != this)
+      continue;
+    object->context_ = heir;
+    memory_info_.*field -= object->memory_size();
+    heir->memory_info_.*field += object->memory_size();
+  }
+}
+
+template<class T>
+void WebGLRenderingContext::SetMemorySize(size_t* total, T* object, size_t size) {
+  intptr_t delta = static_cast<intptr_t>(size) - static_cast<intptr_t>(object->memory_size());
+  if (!delta)
+    return;
+  object->set_memory_size(size);
+  *total += delta;
+  Runtime::Current()->AdjustExternalMemory(delta);
+}
+
+static size_t TextureLevelSize(GLenum format, GLenum type, GLsizei width, GLsizei height) {
+  size_t components = 0;
+  switch (format) {
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+      components = 1;
+      break;
+    case GL_LUMINANCE_ALPHA:
+      components = 2;
+      break;
+    case GL_RGB:
+      components = 3;
+      break;
+    case GL_RGBA:
+      components = 4;
+      break;
+  }
+  size_t pixel_size = 0;
+  switch (type) {
+    case GL_UNSIGNED_BYTE:
+      pixel_size = components;
+      break;
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+      pixel_size = 2;
+      break;
+    case GL_FLOAT:
+      pixel_size = components * sizeof(GLfloat);
+      break;
+  }
+  return pixel_size * width * height;
+}
+
+void WebGLRenderingContext::SetTextureLevelMemory(GLenum target, GLint level, GLenum format, GLenum type, GLsizei width, GLsizei height) {
+  GLint texture_id = 0;
+  GetIntegerv(target == GL_TEXTURE_2D ? GL_TEXTURE_BINDING_2D : GL_TEXTURE_BINDING_CUBE_MAP, &texture_id);
+  WebGLTexture* texture = IdToTexture(texture_id);
+  if (!texture)
+    return;
+  size_t size = texture->LevelMemorySize(target, level, TextureLevelSize(format, type, width, height));
+  // Shared textures are accounted to the context that created them
+  SetMemorySize(&texture->context_->memory_info_.texture_bytes, texture, size);
+}
+
+void WebGLRenderingContext::DisposeObject(WebGLBuffer* buffer) {
+  SetMemorySize(&memory_info_.buffer_bytes, buffer, 0);
+  DisposeObject(buffer_table_, ReleasedNames(&name_pool_.buffers, &delete_queue_.buffers, buffer), buffer);
+}
+
+void WebGLRenderingContext::DisposeObject(WebGLFramebuffer* framebuffer) {
+  DisposeObject(framebuffer_table_, ReleasedNames(&name_pool_.framebuffers, &delete_queue_.framebuffers, framebuffer), framebuffer);
+}
+
+void WebGLRenderingContext::DisposeObject(WebGLProgram* program) {
+  DeleteProgramVariants(program, true);
+  DisposeObject(program_table_, &delete_queue_.programs, program);
+}
+
+void WebGLRenderingContext::DisposeObject(WebGLRenderbuffer* renderbuffer) {
+  SetMemorySize(&memory_info_.renderbuffer_bytes, renderbuffer, 0);
+  DisposeObject(renderbuffer_table_, ReleasedNames(&name_pool_.renderbuffers, &delete_queue_.renderbuffers, renderbuffer), renderbuffer);
+}
+
+void WebGLRenderingContext::DisposeObject(WebGLShader* shader) {
+  DisposeObject(shader_table_, &delete_queue_.shaders, shader);
+}
+
+void WebGLRenderingContext::DisposeObject(WebGLTexture* texture) {
+  SetMemorySize(&memory_info_.texture_bytes, texture, 0);
+  DisposeObject(texture_table_, ReleasedNames(&name_pool_.textures, &delete_queue_.textures, texture), texture);
 }
 
 WebGLActiveInfo* WebGLRenderingContext::CreateActiveInfo(GLint size, GLenum type, const char* name) {
@@ -53,78 +345,70 @@ WebGLActiveInfo* WebGLRenderingContext::CreateActiveInfo(GLint size, GLenum type
 
 WebGLBuffer* WebGLRenderingContext::CreateBuffer(GLuint buffer_id) {
   WebGLBuffer* buffer = new WebGLBuffer(this, buffer_id);
-  buffer_map_[buffer_id] = buffer;
-  return buffer;
+  return InsertObject(buffer_table_, buffer);
 }
 
 WebGLFramebuffer* WebGLRenderingContext::CreateFramebuffer(GLuint framebuffer_id) {
   WebGLFramebuffer* framebuffer = new WebGLFramebuffer(this, framebuffer_id);
-  framebuffer_map_[framebuffer_id] = framebuffer;
-  return framebuffer;
+  return InsertObject(framebuffer_table_, framebuffer);
 }
 
 WebGLProgram* WebGLRenderingContext::CreateProgram(GLuint program_id) {
   WebGLProgram* program = new WebGLProgram(this, program_id);
-  program_map_[program_id] = program;
-  return program;
+  return InsertObject(program_table_, program);
 }
 
 WebGLRenderbuffer* WebGLRenderingContext::CreateRenderbuffer(GLuint renderbuffer_id) {
   WebGLRenderbuffer* renderbuffer = new WebGLRenderbuffer(this, renderbuffer_id);
-  renderbuffer_map_[renderbuffer_id] = renderbuffer;
-  return renderbuffer;
+  return InsertObject(renderbuffer_table_, renderbuffer);
 }
 
 WebGLShader* WebGLRenderingContext::CreateShader(GLuint shader_id) {
   WebGLShader* shader = new WebGLShader(this, shader_id);
-  shader_map_[shader_id] = shader;
-  return shader;
+  return InsertObject(shader_table_, shader);
 }
 
 WebGLTexture* WebGLRenderingContext::CreateTexture(GLuint texture_id) {
   WebGLTexture* texture = new WebGLTexture(this, texture_id);
-  texture_map_[texture_id] = texture;
-  return texture;
+  return InsertObject(texture_table_, texture);
 }
 
-WebGLUniformLocation* WebGLRenderingContext::CreateUniformLocation(GLuint program_id, GLint location_id) {
-  return new WebGLUniformLocation(this, program_id, location_id);
+WebGLUniformLocation* WebGLRenderingContext::CreateUniformLocation(GLuint program_id, GLint location_id, const std::string& name) {
+  return new WebGLUniformLocation(this, program_id, location_id, name);
 }
 
 void WebGLRenderingContext::DeleteBuffer(WebGLBuffer* buffer) {
   if (!buffer) return;
-  buffer_map_.erase(buffer->webgl_id());
-  delete buffer;
+  SetMemorySize(&buffer->context_->memory_info_.buffer_bytes, buffer, 0);
+  RemoveObject(buffer_table_, buffer);
 }
 
 void WebGLRenderingContext::DeleteFramebuffer(WebGLFramebuffer* framebuffer) {
   if (!framebuffer) return;
-  framebuffer_map_.erase(framebuffer->webgl_id());
-  delete framebuffer;
+  RemoveObject(framebuffer_table_, framebuffer);
 }
 
 void WebGLRenderingContext::DeleteProgram(WebGLProgram* program) {
   if (!program) return;
-  program_map_.erase(program->webgl_id());
-  delete program;
+  DeleteProgramVariants(program);
+  RemoveObject(program_table_, program);
 }
 
 void WebGLRenderingContext::DeleteRenderbuffer(WebGLRenderbuffer* renderbuffer) {
   if (!renderbuffer) return;
-  renderbuffer_map_.erase(renderbuffer->webgl_id());
-  delete renderbuffer;
+  SetMemorySize(&memory_info_.renderbuffer_bytes, renderbuffer, 0);
+  RemoveObject(renderbuffer_table_, renderbuffer);
 }
 
 void WebGLRenderingContext::DeleteShader(WebGLShader* shader) {
   if (!shader) return;
-  shader_map_.erase(shader->webgl_id());
-  delete shader;
+  RemoveObject(shader_table_, shader);
 }
 
 void WebGLRenderingContext::DeleteTexture(WebGLTexture* texture) {
   if (!texture) return;
-  texture_map_.erase(texture->webgl_id());
-  delete texture;
+  SetMemorySize(&texture->context_->memory_info_.texture_bytes, texture, 0);
+  RemoveObject(texture_table_, texture);
 }
 
 void WebGLRenderingContext::set_gl_error(GLenum error) {
@@ -132,6 +416,20 @@ void WebGLRenderingContext::set_gl_error(GLenum error) {
     gl_error_ = error;
 }
 
+void WebGLRenderingContext::SaveGLError() {
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR)
+    set_gl_error(error);
+}
+
+bool WebGLRenderingContext::GLCallSucceeded() {
+  GLenum error = glGetError();
+  if (error == GL_NO_ERROR)
+    return true;
+  set_gl_error(error);
+  return false;
+}
+
 GLenum WebGLRenderingContext::gl_error() {
   if (gl_error_ != GL_NONE) {
     GLenum err = gl_error_;
@@ -186,7 +484,492 @@ bool WebGLRenderingContext::TypedArrayToData(v8::Handle<v8::Value> value, void**
   return false;
 }
 
-WebGLUniformLocation* WebGLRenderingContext::UniformLocationFromV8(v8::Handle<v8::Value> value) {
+bool WebGLRenderingContext::TranslateShader(WebGLShader* shader, GLenum shader_type, std::string* translated_source, ShaderCompileRecord* record) {
+  std::string shader_log;
+  double start = MonotonicTimeMs();
+  bool is_valid = shader_compiler_.TranslateShaderSource
+                  (shader->source().c_str(), shader_type,
+                   translated_source, &shader_log,
+                   &shader->attributes(), &shader->uniforms());
+  record->translate_time = MonotonicTimeMs() - start;
+  record->shader_type = shader_type;
+  record->source_size = shader->source().size();
+  shader->set_compiled_source(shader->source());
+  record->translated_size = translated_source->size();
+  record->valid = is_valid;
+  shader->set_is_valid(is_valid);
+  shader->set_log(shader_log);
+  return is_valid;
+}
+
+// If check_status is false the driver may still be compiling on return,
+// and the wait is paid by whatever next needs the result.
+void WebGLRenderingContext::CompileTranslatedShader(WebGLShader* shader, const std::string& translated_source, bool check_status, ShaderCompileRecord* record) {
+  GLuint shader_id = shader->webgl_id();
+  const char* shader_source[] = { translated_source.c_str() };
+  double start = MonotonicTimeMs();
+  glShaderSource(shader_id, 1, shader_source, NULL);
+  glCompileShader(shader_id);
+  if (check_status) {
+    GLint compile_status = 0;
+    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compile_status);
+    if (compile_status != GL_TRUE) {
+      Log(Logger::kError, "%s: %s", "compileShader", "translated shader failed to compile.");
+      shader->set_is_valid(false);
+      shader->set_log("Internal error: translated shader failed to compile.");
+      record->valid = false;
+    }
+  }
+  record->compile_time = MonotonicTimeMs() - start;
+}
+
+void WebGLRenderingContext::RecordShaderCompile(const ShaderCompileRecord& record) {
+  shader_stats_.translate_times.Add(record.translate_time);
+  if (record.valid)
+    shader_stats_.compile_times.Add(record.compile_time);
+  std::vector<ShaderCompileRecord>& shaders = shader_stats_.shaders;
+  if (shaders.size() >= ShaderStats::kMaxRecords)
+    shaders.erase(shaders.begin());
+  shaders.push_back(record);
+}
+
+void WebGLRenderingContext::RecordProgramLink(double link_time, bool linked) {
+  shader_stats_.link_times.Add(link_time);
+  std::vector<ProgramLinkRecord>& programs = shader_stats_.programs;
+  if (programs.size() >= ShaderStats::kMaxRecords)
+    programs.erase(programs.begin());
+  programs.push_back(ProgramLinkRecord(link_time, linked));
+}
+
+// Query the link result once and cache it on the program, along with the
+// active variables merged from the attached shaders' reflection data.
+void WebGLRenderingContext::UpdateLinkStatus(WebGLProgram* program) {
+  GLuint program_id = program->webgl_id();
+  GLint link_status = 0;
+  glGetProgramiv(program_id, GL_LINK_STATUS, &link_status);
+  program->set_link_status(link_status == GL_TRUE);
+  DeleteProgramVariants(program);
+  program->linked_vertex_source().clear();
+  program->linked_fragment_source().clear();
+  program->linked_attribute_locations().clear();
+
+  ShaderVariableList& attributes = program->active_attributes();
+  ShaderVariableList& uniforms = program->active_uniforms();
+  attributes.clear();
+  uniforms.clear();
+  program->set_has_variables(false);
+  if (link_status != GL_TRUE)
+    return;
+
+  GLuint shader_ids[2] = { 0, 0 };
+  GLsizei count = 0;
+  glGetAttachedShaders(program_id, 2, &count, shader_ids);
+  for (GLsizei i = 0; i < count; i++) {
+    // Shader deleted while attached, or never translated - fall back to GL
+    WebGLShader* shader = IdToShader(shader_ids[i]);
+    if (!shader || !shader->is_valid()) {
+      attributes.clear();
+      uniforms.clear();
+      return;
+    }
+    attributes.insert(attributes.end(), shader->attributes().begin(), shader->attributes().end());
+    GLint shader_type = 0;
+    glGetShaderiv(shader_ids[i], GL_SHADER_TYPE, &shader_type);
+    if (shader_type == GL_VERTEX_SHADER)
+      program->linked_vertex_source() = shader->compiled_source();
+    else
+      program->linked_fragment_source() = shader->compiled_source();
+    // Uniforms declared in both shaders are a single program uniform
+    const ShaderVariableList& shader_uniforms = shader->uniforms();
+    for (size_t j = 0; j < shader_uniforms.size(); j++) {
+      size_t k = 0;
+      while (k < uniforms.size() && uniforms[k].name != shader_uniforms[j].name)
+        k++;
+      if (k == uniforms.size())
+        uniforms.push_back(shader_uniforms[j]);
+    }
+  }
+  // Reflection lists every declared variable, keep only those the
+  // driver left active so counts and indices match WebGL semantics
+  size_t active_count = 0;
+  for (size_t i = 0; i < attributes.size(); i++) {
+    GLint location = glGetAttribLocation(program_id, attributes[i].name.c_str());
+    if (location < 0)
+      continue;
+    program->linked_attribute_locations().push_back(std::make_pair(attributes[i].name, location));
+    attributes[active_count++] = attributes[i];
+  }
+  attributes.erase(attributes.begin() + active_count, attributes.end());
+  active_count = 0;
+  for (size_t i = 0; i < uniforms.size(); i++) {
+    if (glGetUniformLocation(program_id, uniforms[i].name.c_str()) < 0)
+      continue;
+    uniforms[active_count++] = uniforms[i];
+  }
+  uniforms.erase(uniforms.begin() + active_count, uniforms.end());
+  program->set_has_variables(true);
+}
+
+// Program id to bind for program, building the variant for its current
+// specialization constants on first use.
+GLuint WebGLRenderingContext::ProgramVariantId(WebGLProgram* program) {
+  if (program->specialization_constants().empty() || !program->has_variables())
+    return program->webgl_id();
+  std::string key = SpecializationKey(program->specialization_constants());
+  WebGLProgram::VariantMap& variants = program->variants();
+  WebGLProgram::VariantMap::iterator it = variants.find(key);
+  if (it != variants.end())
+    return it->second.program_id;
+
+  // Cache failures as the base program so we only try once
+  GLuint variant_id = BuildProgramVariant(program);
+  if (variant_id)
+    program_variant_table_.Insert(variant_id, program);
+  else
+    variant_id = program->webgl_id();
+  variants[key].program_id = variant_id;
+  return variant_id;
+}
+
+// Returns 0 if the specialized program does not translate or link.
+GLuint WebGLRenderingContext::BuildProgramVariant(WebGLProgram* program) {
+  const SpecializationConstants& constants = program->specialization_constants();
+  const GLenum shader_types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+  const std::string* sources[] = { &program->linked_vertex_source(), &program->linked_fragment_source() };
+
+  GLuint variant_id = glCreateProgram();
+  for (int i = 0; i < 2; i++) {
+    std::string source = SpecializeShaderSource(*sources[i], constants);
+    std::string translated_source;
+    std::string shader_log;
+    ShaderVariableList attributes;
+    ShaderVariableList uniforms;
+    if (!shader_compiler_.TranslateShaderSource(source.c_str(), shader_types[i],
+                                                &translated_source, &shader_log,
+                                                &attributes, &uniforms)) {
+      Log(Logger::kWarn, "%s: %s %s", "useProgram", "specialized shader failed to translate:", shader_log.c_str());
+      glDeleteProgram(variant_id);
+      return 0;
+    }
+    GLuint shader_id = glCreateShader(shader_types[i]);
+    const char* shader_source[] = { translated_source.c_str() };
+    glShaderSource(shader_id, 1, shader_source, NULL);
+    glCompileShader(shader_id);
+    glAttachShader(variant_id, shader_id);
+    // Only flagged for deletion while attached, freed with the variant
+    glDeleteShader(shader_id);
+  }
+
+  const WebGLProgram::AttributeLocations& attribute_locations = program->linked_attribute_locations();
+  for (size_t i = 0; i < attribute_locations.size(); i++) {
+    if (attribute_locations[i].second >= 0)
+      glBindAttribLocation(variant_id, attribute_locations[i].second, attribute_locations[i].first.c_str());
+  }
+  glLinkProgram(variant_id);
+  GLint link_status = 0;
+  glGetProgramiv(variant_id, GL_LINK_STATUS, &link_status);
+  if (link_status != GL_TRUE) {
+    Log(Logger::kWarn, "%s: %s", "useProgram", "specialized program failed to link.");
+    glDeleteProgram(variant_id);
+    return 0;
+  }
+  // Uniform values are copied in by UseProgramVariant
+  return variant_id;
+}
+
+// Bind the variant of program for its current specialization constants,
+// carrying over uniform values from the variant used before, so scripts
+// see a single program.
+void WebGLRenderingContext::UseProgramVariant(WebGLProgram* program) {
+  GLuint program_id = ProgramVariantId(program);
+  glUseProgram(program_id);
+  GLuint values_id = program->uniform_values_id();
+  if (program_id == values_id)
+    return;
+  CopyUniformValues(program, values_id, program_id);
+  program->set_uniform_values_id(program_id);
+}
+
+static void CopyUniformValue(GLenum type, GLuint from_id, GLint from_location, GLint to_location) {
+  GLfloat float_value[16] = {0};
+  GLint int_value[4] = {0};
+  switch (type) {
+    case GL_FLOAT:
+    case GL_FLOAT_VEC2:
+    case GL_FLOAT_VEC3:
+    case GL_FLOAT_VEC4:
+    case GL_FLOAT_MAT2:
+    case GL_FLOAT_MAT3:
+    case GL_FLOAT_MAT4:
+      glGetUniformfv(from_id, from_location, float_value);
+      break;
+    default:
+      glGetUniformiv(from_id, from_location, int_value);
+      break;
+  }
+  switch (type) {
+    case GL_FLOAT:
+      glUniform1fv(to_location, 1, float_value);
+      break;
+    case GL_FLOAT_VEC2:
+      glUniform2fv(to_location, 1, float_value);
+      break;
+    case GL_FLOAT_VEC3:
+      glUniform3fv(to_location, 1, float_value);
+      break;
+    case GL_FLOAT_VEC4:
+      glUniform4fv(to_location, 1, float_value);
+      break;
+    case GL_FLOAT_MAT2:
+      glUniformMatrix2fv(to_location, 1, GL_FALSE, float_value);
+      break;
+    case GL_FLOAT_MAT3:
+      glUniformMatrix3fv(to_location, 1, GL_FALSE, float_value);
+      break;
+    case GL_FLOAT_MAT4:
+      glUniformMatrix4fv(to_location, 1, GL_FALSE, float_value);
+      break;
+    case GL_INT:
+    case GL_BOOL:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_CUBE:
+      glUniform1iv(to_location, 1, int_value);
+      break;
+    case GL_INT_VEC2:
+    case GL_BOOL_VEC2:
+      glUniform2iv(to_location, 1, int_value);
+      break;
+    case GL_INT_VEC3:
+    case GL_BOOL_VEC3:
+      glUniform3iv(to_location, 1, int_value);
+      break;
+    case GL_INT_VEC4:
+    case GL_BOOL_VEC4:
+      glUniform4iv(to_location, 1, int_value);
+      break;
+  }
+}
+
+// Copy the values of program's active uniforms from program object
+// from_id to to_id, which must be current. Uniforms specialized to
+// constants in either one are skipped.
+void WebGLRenderingContext::CopyUniformValues(WebGLProgram* program, GLuint from_id, GLuint to_id) {
+  const ShaderVariableList& uniforms = program->active_uniforms();
+  for (size_t i = 0; i < uniforms.size(); i++) {
+    const ShaderVariable& uniform = uniforms[i];
+    // Translator names of arrays end in "[0]"
+    std::string base_name(uniform.name);
+    bool is_array = base_name.size() > 3 && base_name.compare(base_name.size() - 3, 3, "[0]") == 0;
+    if (is_array)
+      base_name.resize(base_name.size() - 3);
+    for (GLint index = 0; index < uniform.size; index++) {
+      std::string name(base_name);
+      if (is_array) {
+        std::ostringstream ss;
+        ss << base_name << "[" << index << "]";
+        name = ss.str();
+      }
+      GLint from_location = glGetUniformLocation(from_id, name.c_str());
+      GLint to_location = glGetUniformLocation(to_id, name.c_str());
+      if (from_location < 0 || to_location < 0)
+        continue;
+      CopyUniformValue(uniform.type, from_id, from_location, to_location);
+    }
+  }
+}
+
+void WebGLRenderingContext::DeleteProgramVariants(WebGLProgram* program, bool defer) {
+  program->set_uniform_values_id(program->webgl_id());
+  WebGLProgram::VariantMap& variants = program->variants();
+  WebGLProgram::VariantMap::iterator it;
+  for (it = variants.begin(); it != variants.end(); it++) {
+    GLuint variant_id = it->second.program_id;
+    if (variant_id == program->webgl_id())
+      continue;
+    if (defer) {
+      delete_queue_.programs.push_back(variant_id);
+      delete_queue_.pending = true;
+    } else
+      glDeleteProgram(variant_id);
+    program_variant_table_.Remove(variant_id);
+  }
+  variants.clear();
+}
+
+GLint WebGLRenderingContext::VariantUniformLocation(WebGLProgram* program, GLuint variant_id, WebGLUniformLocation* location) {
+  WebGLProgram::VariantMap& variants = program->variants();
+  WebGLProgram::VariantMap::iterator it;
+  for (it = variants.begin(); it != variants.end(); it++) {
+    if (it->second.program_id != variant_id)
+      continue;
+    std::map<GLint, GLint>& uniform_locations = it->second.uniform_locations;
+    std::map<GLint, GLint>::iterator found = uniform_locations.find(location->webgl_id());
+    if (found != uniform_locations.end())
+      return found->second;
+    // Specialized uniforms no longer exist in the variant and map to -1
+    GLint variant_location = glGetUniformLocation(variant_id, location->name().c_str());
+    uniform_locations[location->webgl_id()] = variant_location;
+    return variant_location;
+  }
+  return location->webgl_id();
+}
+
+// Each phase runs over the whole batch before the next starts, so drivers
+// that compile and link on background threads can overlap the work instead
+// of stalling on every program in turn.
+void WebGLRenderingContext::PrecompilePrograms(const std::vector<ProgramSource>& sources, std::vector<ProgramTimings>* timings) {
+  size_t count = sources.size();
+  timings->assign(count, ProgramTimings());
+  std::vector<WebGLShader*> shaders(count * 2);
+  std::vector<std::string> translated_sources(count * 2);
+  std::vector<ShaderCompileRecord> records(count * 2);
+  std::vector<bool> valid(count);
+  std::vector<WebGLProgram*> programs(count);
+
+  for (size_t i = 0; i < count; i++) {
+    double start = MonotonicTimeMs();
+    WebGLShader* vertex_shader = CreateShader(glCreateShader(GL_VERTEX_SHADER));
+    WebGLShader* fragment_shader = CreateShader(glCreateShader(GL_FRAGMENT_SHADER));
+    vertex_shader->set_source(sources[i].vertex_source);
+    fragment_shader->set_source(sources[i].fragment_source);
+    bool vertex_valid = TranslateShader(vertex_shader, GL_VERTEX_SHADER, &translated_sources[2 * i], &records[2 * i]);
+    bool fragment_valid = TranslateShader(fragment_shader, GL_FRAGMENT_SHADER, &translated_sources[2 * i + 1], &records[2 * i + 1]);
+    valid[i] = vertex_valid && fragment_valid;
+    shaders[2 * i] = vertex_shader;
+    shaders[2 * i + 1] = fragment_shader;
+    (*timings)[i].translate_time = MonotonicTimeMs() - start;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (!valid[i])
+      continue;
+    double start = MonotonicTimeMs();
+    CompileTranslatedShader(shaders[2 * i], translated_sources[2 * i], false, &records[2 * i]);
+    CompileTranslatedShader(shaders[2 * i + 1], translated_sources[2 * i + 1], false, &records[2 * i + 1]);
+    (*timings)[i].compile_time = MonotonicTimeMs() - start;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    WebGLProgram* program = CreateProgram(glCreateProgram());
+    programs[i] = program;
+    (*timings)[i].program = program->ToV8Object();
+    GLuint program_id = program->webgl_id();
+    glAttachShader(program_id, shaders[2 * i]->webgl_id());
+    glAttachShader(program_id, shaders[2 * i + 1]->webgl_id());
+    if (!valid[i])
+      continue;
+    double start = MonotonicTimeMs();
+    const std::vector<std::string>& attributes = sources[i].attributes;
+    for (size_t j = 0; j < attributes.size(); j++)
+      glBindAttribLocation(program_id, j, attributes[j].c_str());
+    glLinkProgram(program_id);
+    (*timings)[i].link_time = MonotonicTimeMs() - start;
+  }
+
+  // Querying the status blocks until a background link finishes,
+  // so the wait is counted as link time.
+  for (size_t i = 0; i < count; i++) {
+    if (!valid[i])
+      continue;
+    double start = MonotonicTimeMs();
+    UpdateLinkStatus(programs[i]);
+    (*timings)[i].linked = programs[i]->link_status();
+    (*timings)[i].link_time += MonotonicTimeMs() - start;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    RecordShaderCompile(records[2 * i]);
+    RecordShaderCompile(records[2 * i + 1]);
+    if (valid[i])
+      RecordProgramLink((*timings)[i].link_time, (*timings)[i].linked);
+  }
+
+  WarmUpPrograms(programs, timings);
+}
+
+// Draw a single point with each linked program into a 1x1 offscreen target.
+// Drivers often defer final code generation until a program is first drawn
+// with, this moves that cost out of the first real frame.
+void WebGLRenderingContext::WarmUpPrograms(const std::vector<WebGLProgram*>& programs, std::vector<ProgramTimings>* timings) {
+  // Keep any pending error for the application, we discard our own below.
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR)
+    set_gl_error(error);
+
+  GLint saved_program = 0;
+  GLint saved_framebuffer = 0;
+  GLint saved_renderbuffer = 0;
+  GLint saved_array_buffer = 0;
+  GLint saved_viewport[4] = { 0, 0, 0, 0 };
+  glGetIntegerv(GL_CURRENT_PROGRAM, &saved_program);
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &saved_framebuffer);
+  glGetIntegerv(GL_RENDERBUFFER_BINDING, &saved_renderbuffer);
+  glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &saved_array_buffer);
+  glGetIntegerv(GL_VIEWPORT, saved_viewport);
+
+  GLint saved_attrib_enabled = 0;
+  GLint saved_attrib_buffer = 0;
+  GLint saved_attrib_size = 4;
+  GLint saved_attrib_type = GL_FLOAT;
+  GLint saved_attrib_normalized = 0;
+  GLint saved_attrib_stride = 0;
+  GLvoid* saved_attrib_pointer = NULL;
+  glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &saved_attrib_enabled);
+  glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &saved_attrib_buffer);
+  glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_SIZE, &saved_attrib_size);
+  glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_TYPE, &saved_attrib_type);
+  glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &saved_attrib_normalized);
+  glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &saved_attrib_stride);
+  glGetVertexAttribPointerv(0, GL_VERTEX_ATTRIB_ARRAY_POINTER, &saved_attrib_pointer);
+
+  GLuint framebuffer_id = 0;
+  GLuint renderbuffer_id = 0;
+  GLuint buffer_id = 0;
+  glGenFramebuffers(1, &framebuffer_id);
+  glGenRenderbuffers(1, &renderbuffer_id);
+  glGenBuffers(1, &buffer_id);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_id);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA4, 1, 1);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer_id);
+  glViewport(0, 0, 1, 1);
+
+  static const GLfloat vertex[] = { 0, 0, 0, 1 };
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertex), vertex, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+
+  for (size_t i = 0; i < programs.size(); i++) {
+    if (!(*timings)[i].linked)
+      continue;
+    double start = MonotonicTimeMs();
+    glUseProgram(programs[i]->webgl_id());
+    glDrawArrays(GL_POINTS, 0, 1);
+    glFinish();
+    (*timings)[i].warmup_time = MonotonicTimeMs() - start;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, saved_attrib_buffer);
+  glVertexAttribPointer(0, saved_attrib_size, saved_attrib_type, saved_attrib_normalized,
+                        saved_attrib_stride, saved_attrib_pointer);
+  if (!saved_attrib_enabled)
+    glDisableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, saved_array_buffer);
+  glUseProgram(saved_program);
+  glBindFramebuffer(GL_FRAMEBUFFER, saved_framebuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, saved_renderbuffer);
+  glViewport(saved_viewport[0], saved_viewport[1], saved_viewport[2], saved_viewport[3]);
+
+  glDeleteBuffers(1, &buffer_id);
+  glDeleteFramebuffers(1, &framebuffer_id);
+  glDeleteRenderbuffers(1, &renderbuffer_id);
+
+  while (glGetError() != GL_NO_ERROR) {}
+}
+
+WebGLUniformLocation* WebGLRenderingContext::UniformLocationFromV8(v8::Handle<v8::Value> value, GLint* location_id) {
   bool ok = true;
   WebGLUniformLocation* location = NativeFromV8<WebGLUniformLocation>(value, &ok);
   // It's not an error if location is null
@@ -195,10 +978,16 @@ WebGLUniformLocation* WebGLRenderingContext::UniformLocationFromV8(v8::Handle<v8
   if (!ValidateObject(location))
     return NULL;
 
-  GLint program_id = 0;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &program_id);
+  GLint current_program_id = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &current_program_id);
+  // A specialized variant stands in for its base program
+  WebGLProgram* program = IdToProgram(current_program_id);
+  GLuint program_id = program ? program->webgl_id() : current_program_id;
   if (!ValidateLocationProgram(location, program_id))
     return NULL;
+  *location_id = location->webgl_id();
+  if (program && program_id != static_cast<GLuint>(current_program_id))
+    *location_id = VariantUniformLocation(program, current_program_id, location);
   return location;
 }
 
@@ -528,6 +1317,8 @@ void WebGLRenderingContext::ConfigureConstructorTemplate(v8::Persistent<v8::Func
   PROTO_METHOD(depthRange, 2);
   PROTO_METHOD(detachShader, 2);
   PROTO_METHOD(disable, 1);
+  // Must not make a disposed context current
+  AddCallback(proto, "dispose", InvocationCallbackDispatcher<WebGLRenderingContext, 0, &WebGLRenderingContext::Callback_dispose>, signature);
   PROTO_METHOD(disableVertexAttribArray, 1);
   PROTO_METHOD(drawArrays, 3);
   PROTO_METHOD(drawElements, 4);
@@ -547,12 +1338,14 @@ void WebGLRenderingContext::ConfigureConstructorTemplate(v8::Persistent<v8::Func
   PROTO_METHOD(getBufferParameter, 2);
   PROTO_METHOD(getError, 0);
   PROTO_METHOD(getFramebufferAttachmentParameter, 3);
+  PROTO_METHOD(getMemoryInfo, 0);
   PROTO_METHOD(getProgramParameter, 2);
   PROTO_METHOD(getProgramInfoLog, 1);
   PROTO_METHOD(getRenderbufferParameter, 2);
   PROTO_METHOD(getShaderParameter, 2);
   PROTO_METHOD(getShaderInfoLog, 1);
   PROTO_METHOD(getShaderSource, 1);
+  PROTO_METHOD(getShaderStats, 0);
   PROTO_METHOD(getTexParameter, 2);
   PROTO_METHOD(getUniform, 2);
   PROTO_METHOD(getUniformLocation, 2);
@@ -570,10 +1363,12 @@ void WebGLRenderingContext::ConfigureConstructorTemplate(v8::Persistent<v8::Func
   PROTO_METHOD(linkProgram, 1);
   PROTO_METHOD(pixelStorei, 2);
   PROTO_METHOD(polygonOffset, 2);
+  PROTO_METHOD(precompilePrograms, 1);
   PROTO_METHOD(readPixels, 7);
   PROTO_METHOD(renderbufferStorage, 4);
   PROTO_METHOD(sampleCoverage, 2);
   PROTO_METHOD(scissor, 4);
+  PROTO_METHOD(setSpecializationConstants, 2);
   PROTO_METHOD(shaderSource, 2);
   PROTO_METHOD(stencilFunc, 3);
   PROTO_METHOD(stencilFuncSeparate, 4);
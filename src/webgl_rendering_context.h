@@ -7,14 +7,29 @@
 
 #include <v8_webgl.h>
 #include "v8_binding.h"
+#include "object_table.h"
 #include "shader_compiler.h"
-#include <map>
+#include <string>
+#include <vector>
 
 #include "gl.h"
 
 namespace v8_webgl {
 class GraphicContext;
+
+// Options passed to getContext.
+struct ContextAttributes {
+  ContextAttributes() : trusted_shaders(false) {}
+  // Shaders are compiled to the GLSL ES spec instead of WebGL,
+  // allowed only if Factory::AllowTrustedShaders().
+  bool trusted_shaders;
+  // Name of the ShareGroup, empty for an unshared context,
+  // allowed only if Factory::CanShareGraphicContexts().
+  std::string share_group;
+};
+
 class Canvas;
+class ShareGroup;
 class WebGLObjectInterface;
 class WebGLActiveInfo;
 class WebGLBuffer;
@@ -34,52 +49,150 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
   static const char* const ClassName() { return "WebGLRenderingContext"; }
   static void ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> constructor);
 
+  // Skips the switch if this context is already current.
   inline void MakeCurrent() {
-    graphic_context_->MakeCurrent();
+    Runtime* runtime = Runtime::Current();
+    WebGLRenderingContext* previous = runtime->current_context();
+    if (previous != this) {
+      // Other contexts of a share group see commands only once flushed
+      if (previous && previous->shared_)
+        glFlush();
+      graphic_context_->MakeCurrent();
+      runtime->set_current_context(this);
+    }
+    if (delete_queue_.pending)
+      DrainDeleteQueue();
+  }
+
+  // Context must be current, see Runtime::ReleaseCurrentContext.
+  void ReleaseCurrent() {
+    if (shared_)
+      glFlush();
+    graphic_context_->ReleaseCurrent();
   }
 
+  // No-op once disposed, the canvas keeps its size for the next context.
   inline void Resize(int width, int height) {
-    graphic_context_->Resize(width, height);
+    if (!is_disposed())
+      graphic_context_->Resize(width, height);
   }
 
   unsigned long get_context_id() { return context_id_; }
+  // Owner of shareable objects, the context id for unshared contexts.
+  unsigned long get_share_group_id() { return share_group_id_; }
+
+  // Delete all GL objects and the graphic context now. The native objects
+  // of live WebGL objects are deleted, so their instances throw on use.
+  void Dispose();
+  bool is_disposed() { return graphic_context_ == 0; }
+
+  // Delete GL objects released by dispose() calls now instead of at the
+  // next call on the context. Embedders can call this at frame end.
+  void FlushDeleteQueue() {
+    if (!is_disposed())
+      MakeCurrent();
+  }
+
+  void PrecompilePrograms(const std::vector<ProgramSource>& sources, std::vector<ProgramTimings>* timings);
+  const ShaderStats& shader_stats() { return shader_stats_; }
+  const MemoryInfo& memory_info() { return memory_info_; }
+
+  // Framebuffer bound by bindFramebuffer(null), 0 for the drawing buffer.
+  void set_default_framebuffer(GLuint framebuffer) { default_framebuffer_ = framebuffer; }
 
  protected:
-  WebGLRenderingContext(int width, int height);
+  WebGLRenderingContext(int width, int height, const ContextAttributes& attributes);
   ~WebGLRenderingContext();
 
  private:
   GraphicContext* graphic_context_;
   unsigned long context_id_;
+  ShareGroup* share_group_;
+  unsigned long share_group_id_;
+  bool shared_;
   GLenum gl_error_;
+  GLuint default_framebuffer_;
   ShaderCompiler shader_compiler_;
+  ShaderStats shader_stats_;
+  MemoryInfo memory_info_;
 
-  std::map<GLuint, WebGLBuffer*> buffer_map_;
-  std::map<GLuint, WebGLFramebuffer*> framebuffer_map_;
-  std::map<GLuint, WebGLProgram*> program_map_;
-  std::map<GLuint, WebGLRenderbuffer*> renderbuffer_map_;
-  std::map<GLuint, WebGLShader*> shader_map_;
-  std::map<GLuint, WebGLTexture*> texture_map_;
+  // Buffers and textures are owned by the ShareGroup
+  ObjectTable<WebGLBuffer>& buffer_table_;
+  ObjectTable<WebGLFramebuffer> framebuffer_table_;
+  ObjectTable<WebGLProgram> program_table_;
+  // Maps specialized variant programs to their base program, not owned
+  ObjectTable<WebGLProgram> program_variant_table_;
+  ObjectTable<WebGLRenderbuffer> renderbuffer_table_;
+  ObjectTable<WebGLShader> shader_table_;
+  ObjectTable<WebGLTexture>& texture_table_;
 
+  // GL names of objects disposed while the context may not be current,
+  // deleted in batches by FlushDeleteQueue.
+  struct DeleteQueue {
+    DeleteQueue() : pending(false) {}
+    bool pending;
+    std::vector<GLuint> buffers;
+    std::vector<GLuint> framebuffers;
+    std::vector<GLuint> programs;
+    std::vector<GLuint> renderbuffers;
+    std::vector<GLuint> shaders;
+    std::vector<GLuint> textures;
+  };
+  DeleteQueue delete_queue_;
+  // Context must be current
+  void DrainDeleteQueue();
+  // Restore the GL state of a new context before the graphic context is
+  // pooled for reuse. Context must be current.
+  void ResetGLState();
+
+  // Names generated kNameBlockSize at a time for create* calls, and names
+  // of objects deleted before they were ever bound, which have no GL object.
+  enum { kNameBlockSize = 64 };
+  struct NamePool {
+    std::vector<GLuint> buffers;
+    std::vector<GLuint> framebuffers;
+    std::vector<GLuint> renderbuffers;
+    std::vector<GLuint> textures;
+  };
+  NamePool name_pool_;
+  typedef void (*GenNamesFunction)(GLsizei n, GLuint* names);
+  static GLuint TakeName(std::vector<GLuint>* pool, GenNamesFunction gen_names);
   template<class T>
-  void DeleteMapObjects(std::map<GLuint, T*>& map) {
-    typename std::map<GLuint, T*>::iterator it;
-    for (it = map.begin(); it != map.end(); it++)
-      delete it->second;
+  std::vector<GLuint>* ReleasedNames(std::vector<GLuint>* pool, std::vector<GLuint>* queue, T* object) {
+    return object->has_been_bound() ? queue : pool;
   }
 
   template<class T>
-  T* IdToObject(std::map<GLuint, T*>& map, GLuint id) {
-    typename std::map<GLuint, T*>::iterator it;
-    it = map.find(id);
-    if (it == map.end())
-      return 0;
-    return it->second;
-  }
+  T* InsertObject(ObjectTable<T>& table, T* object);
+  template<class T>
+  void RemoveObject(ObjectTable<T>& table, T* object);
+  template<class T>
+  void DisposeObject(ObjectTable<T>& table, std::vector<GLuint>* names, T* object);
+  template<class T>
+  void DisposeObjects(ObjectTable<T>& table, std::vector<GLuint>* names);
+  // Make heir the context of our objects in a shared table,
+  // moving their memory to its MemoryInfo field.
+  template<class T>
+  void HandOverObjects(ObjectTable<T>& table, size_t MemoryInfo::*field, WebGLRenderingContext* heir);
+
+  // Set the GPU memory held by object, updating the context total
+  // and v8's external memory.
+  template<class T>
+  void SetMemorySize(size_t* total, T* object, size_t size);
+  void SetTextureLevelMemory(GLenum target, GLint level, GLenum format, GLenum type, GLsizei width, GLsizei height);
+
+  void DisposeObject(WebGLBuffer* buffer);
+  void DisposeObject(WebGLFramebuffer* framebuffer);
+  void DisposeObject(WebGLProgram* program);
+  void DisposeObject(WebGLRenderbuffer* renderbuffer);
+  void DisposeObject(WebGLShader* shader);
+  void DisposeObject(WebGLTexture* texture);
 
   // Wraps an InvocationCallback member function, making the context current first.
   template<v8::Handle<v8::Value> (WebGLRenderingContext::*InvocationCallbackMember)(v8::Arguments const&)>
   inline v8::Handle<v8::Value> MakeCurrentCallback(v8::Arguments const& args) {
+    if (is_disposed())
+      return ThrowObjectDisposed();
     MakeCurrent();
     return ((*this).*(InvocationCallbackMember))(args);
   }
@@ -91,7 +204,7 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
   WebGLRenderbuffer* CreateRenderbuffer(GLuint renderbuffer_id);
   WebGLShader* CreateShader(GLuint shader_id);
   WebGLTexture* CreateTexture(GLuint texture_id);
-  WebGLUniformLocation* CreateUniformLocation(GLuint program_id, GLint location_id);
+  WebGLUniformLocation* CreateUniformLocation(GLuint program_id, GLint location_id, const std::string& name);
 
   void DeleteBuffer(WebGLBuffer* buffer);
   void DeleteFramebuffer(WebGLFramebuffer* framebuffer);
@@ -101,26 +214,47 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
   void DeleteTexture(WebGLTexture* texture);
 
   WebGLBuffer* IdToBuffer(GLuint buffer_id) {
-    return IdToObject(buffer_map_, buffer_id);
+    return buffer_table_.Find(buffer_id);
   }
   WebGLFramebuffer* IdToFramebuffer(GLuint framebuffer_id) {
-    return IdToObject(framebuffer_map_, framebuffer_id);
+    return framebuffer_table_.Find(framebuffer_id);
   }
+  // Specialized variants map to their base program
   WebGLProgram* IdToProgram(GLuint program_id) {
-    return IdToObject(program_map_, program_id);
+    WebGLProgram* program = program_table_.Find(program_id);
+    return program ? program : program_variant_table_.Find(program_id);
   }
   WebGLRenderbuffer* IdToRenderbuffer(GLuint renderbuffer_id) {
-    return IdToObject(renderbuffer_map_, renderbuffer_id);
+    return renderbuffer_table_.Find(renderbuffer_id);
   }
   WebGLShader* IdToShader(GLuint shader_id) {
-    return IdToObject(shader_map_, shader_id);
+    return shader_table_.Find(shader_id);
   }
   WebGLTexture* IdToTexture(GLuint texture_id) {
-    return IdToObject(texture_map_, texture_id);
+    return texture_table_.Find(texture_id);
   }
 
+  bool TranslateShader(WebGLShader* shader, GLenum shader_type, std::string* translated_source, ShaderCompileRecord* record);
+  void CompileTranslatedShader(WebGLShader* shader, const std::string& translated_source, bool check_status, ShaderCompileRecord* record);
+  void RecordShaderCompile(const ShaderCompileRecord& record);
+  void RecordProgramLink(double link_time, bool linked);
+  void UpdateLinkStatus(WebGLProgram* program);
+  GLuint ProgramVariantId(WebGLProgram* program);
+  GLuint BuildProgramVariant(WebGLProgram* program);
+  void UseProgramVariant(WebGLProgram* program);
+  void CopyUniformValues(WebGLProgram* program, GLuint from_id, GLuint to_id);
+  // If defer, variant programs are added to the delete queue.
+  void DeleteProgramVariants(WebGLProgram* program, bool defer = false);
+  GLint VariantUniformLocation(WebGLProgram* program, GLuint variant_id, WebGLUniformLocation* location);
+  void WarmUpPrograms(const std::vector<WebGLProgram*>& programs, std::vector<ProgramTimings>* timings);
+
   void set_gl_error(GLenum error);
   GLenum gl_error();
+  // Bracket a GL call whose failure must be detected. SaveGLError keeps
+  // any earlier error for getError, GLCallSucceeded returns false and
+  // records the error if the call failed.
+  void SaveGLError();
+  bool GLCallSucceeded();
 
   static bool TypedArrayToData(v8::Handle<v8::Value> value, void** data, uint32_t* length, bool* ok);
   static void Log(Logger::Level level, const char *fmt, ...);
@@ -138,7 +272,9 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
     }
     return true;
   }
-  WebGLUniformLocation* UniformLocationFromV8(v8::Handle<v8::Value> value);
+  // Returns the location for the current program in location_id,
+  // which differs from location->webgl_id() for specialized variants.
+  WebGLUniformLocation* UniformLocationFromV8(v8::Handle<v8::Value> value, GLint* location_id);
 
   bool ValidateBlendEquation(const char* function, GLenum mode);
   bool ValidateBlendFuncFactors(const char* function, GLenum src, GLenum dst);
@@ -152,9 +288,7 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
   bool ValidateTexParameter(const char* function, GLenum pname, GLint param);
 
   // Use instead of glGetIntegerv
-  void GetIntegerv(GLenum pname, GLint* value);
-
-  static unsigned long s_context_counter;
+  static void GetIntegerv(GLenum pname, GLint* value);
 
   template<typename> friend class UVAHelper;
   template<typename> friend class UniformHelper;
@@ -162,7 +296,9 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
   template<typename> friend class VertexAttribHelper;
 
   friend class Canvas;
+  friend class EffectChainImpl;
   friend class ShaderCompiler;
+  template<class, typename> friend class WebGLObject;
 
 #define CALLBACK(name) v8::Handle<v8::Value> Callback_##name(const v8::Arguments& args)
   CALLBACK(getContextAttributes);
@@ -210,6 +346,7 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
   CALLBACK(depthRange);
   CALLBACK(detachShader);
   CALLBACK(disable);
+  CALLBACK(dispose);
   CALLBACK(disableVertexAttribArray);
   CALLBACK(drawArrays);
   CALLBACK(drawElements);
@@ -229,12 +366,14 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
   CALLBACK(getBufferParameter);
   CALLBACK(getError);
   CALLBACK(getFramebufferAttachmentParameter);
+  CALLBACK(getMemoryInfo);
   CALLBACK(getProgramParameter);
   CALLBACK(getProgramInfoLog);
   CALLBACK(getRenderbufferParameter);
   CALLBACK(getShaderParameter);
   CALLBACK(getShaderInfoLog);
   CALLBACK(getShaderSource);
+  CALLBACK(getShaderStats);
   CALLBACK(getTexParameter);
   CALLBACK(getUniform);
   CALLBACK(getUniformLocation);
@@ -252,10 +391,12 @@ class WebGLRenderingContext : public V8Object<WebGLRenderingContext> {
   CALLBACK(linkProgram);
   CALLBACK(pixelStorei);
   CALLBACK(polygonOffset);
+  CALLBACK(precompilePrograms);
   CALLBACK(readPixels);
   CALLBACK(renderbufferStorage);
   CALLBACK(sampleCoverage);
   CALLBACK(scissor);
+  CALLBACK(setSpecializationConstants);
   CALLBACK(shaderSource);
   CALLBACK(stencilFunc);
   CALLBACK(stencilFuncSeparate);
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "v8_webgl_internal.h"
 #include "typed_array.h"
 #include "webgl_active_info.h"
 #include "webgl_buffer.h"
@@ -12,6 +13,7 @@
 #include "webgl_shader.h"
 #include "webgl_texture.h"
 #include "webgl_uniform_location.h"
+#include "timer.h"
 
 #include <string>
 #include <sstream>
@@ -87,9 +89,8 @@ class UniformHelper : public UVAHelper<TNative> {
  protected:
   int ProcessArgs(const v8::Arguments& args) {
     location_id_ = 0;
-    WebGLUniformLocation* location = this->GetContext()->UniformLocationFromV8(args[0]);
+    WebGLUniformLocation* location = this->GetContext()->UniformLocationFromV8(args[0], &location_id_);
     if (!location) return -1;
-    location_id_ = location->webgl_id();
     return 1;
   }
   void InvokeGL(uint32_t array_length, const TNative* array_data) {
@@ -102,7 +103,7 @@ class UniformHelper : public UVAHelper<TNative> {
   }
 
  private:
-  GLuint location_id_;
+  GLint location_id_;
   UniformCallback gl_callback_;
   uint32_t min_size_;
 };
@@ -120,9 +121,8 @@ class UniformMatrixHelper : public UVAHelper<TNative> {
   int ProcessArgs(const v8::Arguments& args) {
     bool ok = true;
     location_id_ = 0;
-    WebGLUniformLocation* location = this->GetContext()->UniformLocationFromV8(args[0]);
+    WebGLUniformLocation* location = this->GetContext()->UniformLocationFromV8(args[0], &location_id_);
     if (!location) return -1;
-    location_id_ = location->webgl_id();
     bool transpose = FromV8<bool>(args[1], &ok);
     if (!ok)
       return -1;
@@ -143,7 +143,7 @@ class UniformMatrixHelper : public UVAHelper<TNative> {
   }
 
  private:
-  GLuint location_id_;
+  GLint location_id_;
   UniformMatrixCallback gl_callback_;
   uint32_t min_size_;
 };
@@ -248,6 +248,8 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_bindBuffer(const v8::Argum
   }
   WebGLBuffer* buffer = NativeFromV8<WebGLBuffer>(args[1], &ok); if (!ok) return U();
   if (!ValidateObject(buffer)) return U();
+  if (buffer)
+    buffer->set_has_been_bound();
   GLuint buffer_id = buffer ? buffer->webgl_id() : 0;
   glBindBuffer(target, buffer_id);
   return U();
@@ -263,7 +265,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_bindFramebuffer(const v8::
   }
   WebGLFramebuffer* framebuffer = NativeFromV8<WebGLFramebuffer>(args[1], &ok); if (!ok) return U();
   if (!ValidateObject(framebuffer)) return U();
-  GLuint framebuffer_id = framebuffer ? framebuffer->webgl_id() : 0;
+  if (framebuffer)
+    framebuffer->set_has_been_bound();
+  GLuint framebuffer_id = framebuffer ? framebuffer->webgl_id() : default_framebuffer_;
   //XXX glBindFramebufferEXT
   glBindFramebuffer(target, framebuffer_id);
   return U();
@@ -279,6 +283,8 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_bindRenderbuffer(const v8:
   }
   WebGLRenderbuffer* renderbuffer = NativeFromV8<WebGLRenderbuffer>(args[1], &ok); if (!ok) return U();
   if (!ValidateObject(renderbuffer)) return U();
+  if (renderbuffer)
+    renderbuffer->set_has_been_bound();
   GLuint renderbuffer_id = renderbuffer ? renderbuffer->webgl_id() : 0;
   //XXX glBindRenderbufferEXT
   glBindRenderbuffer(target, renderbuffer_id);
@@ -299,6 +305,8 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_bindTexture(const v8::Argu
   }
   WebGLTexture* texture = NativeFromV8<WebGLTexture>(args[1], &ok); if (!ok) return U();
   if (!ValidateObject(texture)) return U();
+  if (texture)
+    texture->set_has_been_bound();
   GLuint texture_id = texture ? texture->webgl_id() : 0;
   glBindTexture(target, texture_id);
   return U();
@@ -386,7 +394,17 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_bufferData(const v8::Argum
   GLenum usage = FromV8<uint32_t>(args[2], &ok); if (!ok) return U();
   if (!ValidateBufferDataParameters("bufferData", target, usage))
     return U();
+  // Only account storage the driver actually allocated
+  SaveGLError();
   glBufferData(target, size, data, usage);
+  if (!GLCallSucceeded())
+    return U();
+
+  GLint buffer_id = 0;
+  GetIntegerv(target == GL_ARRAY_BUFFER ? GL_ARRAY_BUFFER_BINDING : GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffer_id);
+  WebGLBuffer* buffer = IdToBuffer(buffer_id);
+  if (buffer && size >= 0)
+    SetMemorySize(&buffer->context_->memory_info_.buffer_bytes, buffer, size);
   return U();
 }
 
@@ -484,27 +502,12 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_compileShader(const v8::Ar
     return U();
 
   std::string translated_source;
-  std::string shader_log;
-  bool is_valid = shader_compiler_.TranslateShaderSource
-                  (shader->source().c_str(), shader_type,
-                   &translated_source, &shader_log);
-
-  shader->set_is_valid(is_valid);
-  shader->set_log(shader_log);
-  if (!is_valid)
-    return U();
-
-  // Compile translated source
-  const char* shader_source[] = { translated_source.c_str() };
-  glShaderSource(shader_id, 1, shader_source, NULL);
-  glCompileShader(shader_id);
-
-  //XXX should assert translated compile status is GL_TRUE
-#if 0
-  GLint compile_status = 0;
-  glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compile_status);
-#endif
-
+  ShaderCompileRecord record;
+  // Waiting for the driver measures its compile time, but serializes
+  // compiles, so only do it if the embedder asks for it
+  if (TranslateShader(shader, shader_type, &translated_source, &record))
+    CompileTranslatedShader(shader, translated_source, GetFactory()->MeasureShaderCompileTime(), &record);
+  RecordShaderCompile(record);
   return U();
 }
 
@@ -523,7 +526,12 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_copyTexImage2D(const v8::A
   GLint border = FromV8<int32_t>(args[7], &ok); if (!ok) return U();
   if (!ValidateTexFuncParameters("copyTexImage2D", target, level, internalformat, width, height, border, internalformat, GL_UNSIGNED_BYTE))
     return U();
+  // Fails if the read framebuffer is incomplete or has no matching format
+  SaveGLError();
   glCopyTexImage2D(target, level, internalformat, x, y, width, height, border);
+  if (!GLCallSucceeded())
+    return U();
+  SetTextureLevelMemory(target, level, internalformat, GL_UNSIGNED_BYTE, width, height);
   return U();
 }
 
@@ -545,17 +553,15 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_copyTexSubImage2D(const v8
 
 // WebGLBuffer createBuffer();
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_createBuffer(const v8::Arguments& args) {
-  GLuint buffer_id = 0;
-  glGenBuffers(1, &buffer_id);
+  GLuint buffer_id = TakeName(&name_pool_.buffers, glGenBuffers);
   WebGLBuffer* buffer = CreateBuffer(buffer_id);
   return buffer->ToV8Object();
 }
 
 // WebGLFramebuffer createFramebuffer();
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_createFramebuffer(const v8::Arguments& args) {
-  GLuint framebuffer_id = 0;
   //XXX glGenFramebuffersEXT etc.
-  glGenFramebuffers(1, &framebuffer_id);
+  GLuint framebuffer_id = TakeName(&name_pool_.framebuffers, glGenFramebuffers);
   WebGLFramebuffer* framebuffer = CreateFramebuffer(framebuffer_id);
   return framebuffer->ToV8Object();
 }
@@ -569,9 +575,8 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_createProgram(const v8::Ar
 
 // WebGLRenderbuffer createRenderbuffer();
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_createRenderbuffer(const v8::Arguments& args) {
-  GLuint renderbuffer_id = 0;
   //XXX glGenRenderbuffersEXT etc.
-  glGenRenderbuffers(1, &renderbuffer_id);
+  GLuint renderbuffer_id = TakeName(&name_pool_.renderbuffers, glGenRenderbuffers);
   WebGLRenderbuffer* renderbuffer = CreateRenderbuffer(renderbuffer_id);
   return renderbuffer->ToV8Object();
 }
@@ -587,8 +592,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_createShader(const v8::Arg
 
 // WebGLTexture createTexture();
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_createTexture(const v8::Arguments& args) {
-  GLuint texture_id = 0;
-  glGenTextures(1, &texture_id);
+  GLuint texture_id = TakeName(&name_pool_.textures, glGenTextures);
   WebGLTexture* texture = CreateTexture(texture_id);
   return texture->ToV8Object();
 }
@@ -605,9 +609,14 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_cullFace(const v8::Argumen
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteBuffer(const v8::Arguments& args) {
   bool ok = true;
   WebGLBuffer* buffer = NativeFromV8<WebGLBuffer>(args[0], &ok); if (!ok) return U();
+  if (buffer && buffer->is_deleted()) return U();
   if (!ValidateObject(buffer)) return U();
   GLuint buffer_id = buffer ? buffer->webgl_id() : 0;
-  glDeleteBuffers(1, &buffer_id);
+  // Never bound names have no GL object, reuse them
+  if (buffer && !buffer->has_been_bound())
+    name_pool_.buffers.push_back(buffer_id);
+  else
+    glDeleteBuffers(1, &buffer_id);
   DeleteBuffer(buffer);
   return U();
 }
@@ -616,10 +625,22 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteBuffer(const v8::Arg
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteFramebuffer(const v8::Arguments& args) {
   bool ok = true;
   WebGLFramebuffer* framebuffer = NativeFromV8<WebGLFramebuffer>(args[0], &ok); if (!ok) return U();
+  if (framebuffer && framebuffer->is_deleted()) return U();
   if (!ValidateObject(framebuffer)) return U();
   GLuint framebuffer_id = framebuffer ? framebuffer->webgl_id() : 0;
   //XXX glDeleteFramebuffersEXT etc.
-  glDeleteFramebuffers(1, &framebuffer_id);
+  // Never bound names have no GL object, reuse them
+  if (framebuffer && !framebuffer->has_been_bound())
+    name_pool_.framebuffers.push_back(framebuffer_id);
+  else if (default_framebuffer_) {
+    // Deleting the bound framebuffer binds 0, rebind the redirected default
+    GLint bound_id = 0;
+    GetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_id);
+    glDeleteFramebuffers(1, &framebuffer_id);
+    if (static_cast<GLuint>(bound_id) == framebuffer_id)
+      glBindFramebuffer(GL_FRAMEBUFFER, default_framebuffer_);
+  } else
+    glDeleteFramebuffers(1, &framebuffer_id);
   DeleteFramebuffer(framebuffer);
   return U();
 }
@@ -628,6 +649,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteFramebuffer(const v8
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteProgram(const v8::Arguments& args) {
   bool ok = true;
   WebGLProgram* program = NativeFromV8<WebGLProgram>(args[0], &ok); if (!ok) return U();
+  if (program && program->is_deleted()) return U();
   if (!ValidateObject(program)) return U();
   GLuint program_id = program ? program->webgl_id() : 0;
   glDeleteProgram(program_id);
@@ -639,10 +661,15 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteProgram(const v8::Ar
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteRenderbuffer(const v8::Arguments& args) {
   bool ok = true;
   WebGLRenderbuffer* renderbuffer = NativeFromV8<WebGLRenderbuffer>(args[0], &ok); if (!ok) return U();
+  if (renderbuffer && renderbuffer->is_deleted()) return U();
   if (!ValidateObject(renderbuffer)) return U();
   GLuint renderbuffer_id = renderbuffer ? renderbuffer->webgl_id() : 0;
   //XXX glDeleteRenderbuffersEXT etc.
-  glDeleteRenderbuffers(1, &renderbuffer_id);
+  // Never bound names have no GL object, reuse them
+  if (renderbuffer && !renderbuffer->has_been_bound())
+    name_pool_.renderbuffers.push_back(renderbuffer_id);
+  else
+    glDeleteRenderbuffers(1, &renderbuffer_id);
   DeleteRenderbuffer(renderbuffer);
   return U();
 }
@@ -651,6 +678,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteRenderbuffer(const v
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteShader(const v8::Arguments& args) {
   bool ok = true;
   WebGLShader* shader = NativeFromV8<WebGLShader>(args[0], &ok); if (!ok) return U();
+  if (shader && shader->is_deleted()) return U();
   if (!ValidateObject(shader)) return U();
   GLuint shader_id = shader ? shader->webgl_id() : 0;
   glDeleteShader(shader_id);
@@ -662,9 +690,14 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteShader(const v8::Arg
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_deleteTexture(const v8::Arguments& args) {
   bool ok = true;
   WebGLTexture* texture = NativeFromV8<WebGLTexture>(args[0], &ok); if (!ok) return U();
+  if (texture && texture->is_deleted()) return U();
   if (!ValidateObject(texture)) return U();
   GLuint texture_id = texture ? texture->webgl_id() : 0;
-  glDeleteTextures(1, &texture_id);
+  // Never bound names have no GL object, reuse them
+  if (texture && !texture->has_been_bound())
+    name_pool_.textures.push_back(texture_id);
+  else
+    glDeleteTextures(1, &texture_id);
   DeleteTexture(texture);
   return U();
 }
@@ -719,6 +752,15 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_disable(const v8::Argument
   return U();
 }
 
+// Not part of WebGL.
+// void dispose();
+// Deletes all GL objects and the drawing buffer now, instead of when the
+// canvas is collected. Further calls throw.
+v8::Handle<v8::Value> WebGLRenderingContext::Callback_dispose(const v8::Arguments& args) {
+  Dispose();
+  return U();
+}
+
 // void disableVertexAttribArray(GLuint index);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_disableVertexAttribArray(const v8::Arguments& args) {
   bool ok = true;
@@ -848,6 +890,16 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_getActiveAttrib(const v8::
   GLuint program_id = program->webgl_id();
   GLuint index = FromV8<uint32_t>(args[1], &ok); if (!ok) return U();
 
+  if (program->has_variables()) {
+    ShaderVariableList& attributes = program->active_attributes();
+    if (index >= attributes.size()) {
+      set_gl_error(GL_INVALID_VALUE);
+      return v8::Null();
+    }
+    const ShaderVariable& attribute = attributes[index];
+    return CreateActiveInfo(attribute.size, attribute.type, attribute.name.c_str())->ToV8Object();
+  }
+
   GLint max_name_length = 0;
   glGetProgramiv(program_id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_name_length);
   std::vector<char> name_vec(max_name_length);
@@ -868,6 +920,17 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_getActiveUniform(const v8:
   GLuint program_id = program->webgl_id();
   GLuint index = FromV8<uint32_t>(args[1], &ok); if (!ok) return U();
 
+  // Translator names already carry the "[0]" array suffix
+  if (program->has_variables()) {
+    ShaderVariableList& uniforms = program->active_uniforms();
+    if (index >= uniforms.size()) {
+      set_gl_error(GL_INVALID_VALUE);
+      return v8::Null();
+    }
+    const ShaderVariable& uniform = uniforms[index];
+    return CreateActiveInfo(uniform.size, uniform.type, uniform.name.c_str())->ToV8Object();
+  }
+
   GLint max_name_length = 0;
   glGetProgramiv(program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
   std::vector<char> name_vec(max_name_length);
@@ -1194,6 +1257,19 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_getFramebufferAttachmentPa
   }
 }
 
+// Not part of WebGL.
+// Object getMemoryInfo();
+// Returns { buffers, textures, renderbuffers, total }, estimated bytes of
+// GPU memory held by this context's objects. See MemoryInfo.
+v8::Handle<v8::Value> WebGLRenderingContext::Callback_getMemoryInfo(const v8::Arguments& args) {
+  v8::Local<v8::Object> info = v8::Object::New();
+  info->Set(v8::String::New("buffers"), ToV8<double>(memory_info_.buffer_bytes));
+  info->Set(v8::String::New("textures"), ToV8<double>(memory_info_.texture_bytes));
+  info->Set(v8::String::New("renderbuffers"), ToV8<double>(memory_info_.renderbuffer_bytes));
+  info->Set(v8::String::New("total"), ToV8<double>(memory_info_.total_bytes()));
+  return info;
+}
+
 // any getProgramParameter(WebGLProgram program, GLenum pname);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_getProgramParameter(const v8::Arguments& args) {
   bool ok = true;
@@ -1202,22 +1278,37 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_getProgramParameter(const
   if (!ValidateObject(program)) return U();
   GLuint program_id = program->webgl_id();
   GLenum pname = FromV8<uint32_t>(args[1], &ok); if (!ok) return U();
-  GLint value = 0;
-  glGetProgramiv(program_id, pname, &value);
 
+  // Answer from state cached at link where we can
   switch (pname) {
-    case GL_DELETE_STATUS:
-    case GL_VALIDATE_STATUS:
     case GL_LINK_STATUS:
-      return ToV8(static_cast<bool>(value));
-    case GL_ATTACHED_SHADERS:
+      return ToV8(program->link_status());
     case GL_ACTIVE_ATTRIBUTES:
+      if (program->has_variables())
+        return ToV8<int32_t>(program->active_attributes().size());
+      break;
     case GL_ACTIVE_UNIFORMS:
-      return ToV8(value);
+      if (program->has_variables())
+        return ToV8<int32_t>(program->active_uniforms().size());
+      break;
+    case GL_DELETE_STATUS:
+    case GL_VALIDATE_STATUS:
+    case GL_ATTACHED_SHADERS:
+      break;
     default:
       set_gl_error(GL_INVALID_ENUM);
       return v8::Null();
   }
+
+  GLint value = 0;
+  glGetProgramiv(program_id, pname, &value);
+  switch (pname) {
+    case GL_DELETE_STATUS:
+    case GL_VALIDATE_STATUS:
+      return ToV8(static_cast<bool>(value));
+    default:
+      return ToV8(value);
+  }
 }
 
 // DOMString getProgramInfoLog(WebGLProgram program);
@@ -1324,6 +1415,54 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_getShaderSource(const v8::
   return ToV8(shader->source());
 }
 
+static v8::Handle<v8::Value> HistogramToV8(const TimeHistogram& histogram) {
+  v8::Local<v8::Object> object = v8::Object::New();
+  object->Set(v8::String::New("count"), ToV8(histogram.count));
+  object->Set(v8::String::New("total"), ToV8(histogram.total));
+  object->Set(v8::String::New("max"), ToV8(histogram.max));
+  object->Set(v8::String::New("buckets"), ArrayToV8<uint32_t>(const_cast<uint32_t*>(histogram.buckets), TimeHistogram::kBuckets));
+  return object;
+}
+
+// Not part of WebGL.
+// Object getShaderStats();
+// Returns { shaders: [{ type, sourceSize, translatedSize, translateTime, compileTime, valid }],
+//           programs: [{ linkTime, linked }],
+//           translateTimes, compileTimes, linkTimes }
+// Times are in ms. Each *Times histogram is { count, total, max, buckets },
+// see TimeHistogram.
+v8::Handle<v8::Value> WebGLRenderingContext::Callback_getShaderStats(const v8::Arguments& args) {
+  const std::vector<ShaderCompileRecord>& shaders = shader_stats_.shaders;
+  v8::Local<v8::Array> shader_array = v8::Array::New(shaders.size());
+  for (uint32_t i = 0; i < shaders.size(); i++) {
+    v8::Local<v8::Object> entry = v8::Object::New();
+    entry->Set(v8::String::New("type"), ToV8(shaders[i].shader_type));
+    entry->Set(v8::String::New("sourceSize"), ToV8<uint32_t>(shaders[i].source_size));
+    entry->Set(v8::String::New("translatedSize"), ToV8<uint32_t>(shaders[i].translated_size));
+    entry->Set(v8::String::New("translateTime"), ToV8(shaders[i].translate_time));
+    entry->Set(v8::String::New("compileTime"), ToV8(shaders[i].compile_time));
+    entry->Set(v8::String::New("valid"), ToV8(shaders[i].valid));
+    shader_array->Set(i, entry);
+  }
+
+  const std::vector<ProgramLinkRecord>& programs = shader_stats_.programs;
+  v8::Local<v8::Array> program_array = v8::Array::New(programs.size());
+  for (uint32_t i = 0; i < programs.size(); i++) {
+    v8::Local<v8::Object> entry = v8::Object::New();
+    entry->Set(v8::String::New("linkTime"), ToV8(programs[i].link_time));
+    entry->Set(v8::String::New("linked"), ToV8(programs[i].linked));
+    program_array->Set(i, entry);
+  }
+
+  v8::Local<v8::Object> stats = v8::Object::New();
+  stats->Set(v8::String::New("shaders"), shader_array);
+  stats->Set(v8::String::New("programs"), program_array);
+  stats->Set(v8::String::New("translateTimes"), HistogramToV8(shader_stats_.translate_times));
+  stats->Set(v8::String::New("compileTimes"), HistogramToV8(shader_stats_.compile_times));
+  stats->Set(v8::String::New("linkTimes"), HistogramToV8(shader_stats_.link_times));
+  return stats;
+}
+
 // any getTexParameter(GLenum target, GLenum pname);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_getTexParameter(const v8::Arguments& args) {
   bool ok = true;
@@ -1472,24 +1611,37 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_getUniform(const v8::Argum
           return v8::Null();
         }
 
+        // The latest values may live in a specialized variant, unless
+        // the uniform was specialized to a constant there
+        GLuint read_program_id = program_id;
+        GLint read_location_id = location_id;
+        GLuint values_id = program->uniform_values_id();
+        if (values_id != program_id) {
+          GLint variant_location_id = VariantUniformLocation(program, values_id, location);
+          if (variant_location_id >= 0) {
+            read_program_id = values_id;
+            read_location_id = variant_location_id;
+          }
+        }
+
         switch (uniform_base_type) {
           case GL_FLOAT: {
             GLfloat value[16] = {0};
-            glGetUniformfv(program_id, location_id, value);
+            glGetUniformfv(read_program_id, read_location_id, value);
             if (length == 1)
               return ToV8<double>(value[0]);
             return Float32Array::Create(value, length);
           }
           case GL_INT: {
             GLint value[4] = {0};
-            glGetUniformiv(program_id, location_id, value);
+            glGetUniformiv(read_program_id, read_location_id, value);
             if (length == 1)
               return ToV8(value[0]);
             return Int32Array::Create(value, length);
           }
           case GL_BOOL: {
             GLint value[4] = {0};
-            glGetUniformiv(program_id, location_id, value);
+            glGetUniformiv(read_program_id, read_location_id, value);
             if (length > 1) {
               bool bool_value[4] = {0};
               for (uint32_t j = 0; j < length; j++)
@@ -1516,7 +1668,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_getUniformLocation(const v
   GLuint program_id = program->webgl_id();
   std::string name = FromV8<std::string>(args[1], &ok); if (!ok) return U();
   GLint location_id = glGetUniformLocation(program_id, name.c_str());
-  WebGLUniformLocation* location = CreateUniformLocation(program_id, location_id);
+  WebGLUniformLocation* location = CreateUniformLocation(program_id, location_id, name);
   return location->ToV8Object();
 }
 
@@ -1588,7 +1740,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_hint(const v8::Arguments&
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_isBuffer(const v8::Arguments& args) {
   bool ok = true;
   WebGLBuffer* buffer = NativeFromV8<WebGLBuffer>(args[0], &ok); if (!ok) return U();
-  if (!buffer)
+  if (!buffer || !buffer->ValidateContext(this))
     return ToV8(false);
   GLuint buffer_id = buffer ? buffer->webgl_id() : 0;
   return ToV8<bool>(glIsBuffer(buffer_id));
@@ -1608,7 +1760,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_isEnabled(const v8::Argume
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_isFramebuffer(const v8::Arguments& args) {
   bool ok = true;
   WebGLFramebuffer* framebuffer = NativeFromV8<WebGLFramebuffer>(args[0], &ok); if (!ok) return U();
-  if (!framebuffer)
+  if (!framebuffer || !framebuffer->ValidateContext(this))
     return ToV8(false);
   GLuint framebuffer_id = framebuffer ? framebuffer->webgl_id() : 0;
   return ToV8<bool>(glIsFramebuffer(framebuffer_id));
@@ -1618,7 +1770,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_isFramebuffer(const v8::Ar
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_isProgram(const v8::Arguments& args) {
   bool ok = true;
   WebGLProgram* program = NativeFromV8<WebGLProgram>(args[0], &ok); if (!ok) return U();
-  if (!program)
+  if (!program || !program->ValidateContext(this))
     return ToV8(false);
   GLuint program_id = program ? program->webgl_id() : 0;
   return ToV8<bool>(glIsProgram(program_id));
@@ -1628,7 +1780,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_isProgram(const v8::Argume
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_isRenderbuffer(const v8::Arguments& args) {
   bool ok = true;
   WebGLRenderbuffer* renderbuffer = NativeFromV8<WebGLRenderbuffer>(args[0], &ok); if (!ok) return U();
-  if (!renderbuffer)
+  if (!renderbuffer || !renderbuffer->ValidateContext(this))
     return ToV8(false);
   GLuint renderbuffer_id = renderbuffer ? renderbuffer->webgl_id() : 0;
   return ToV8<bool>(glIsRenderbuffer(renderbuffer_id));
@@ -1638,7 +1790,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_isRenderbuffer(const v8::A
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_isShader(const v8::Arguments& args) {
   bool ok = true;
   WebGLShader* shader = NativeFromV8<WebGLShader>(args[0], &ok); if (!ok) return U();
-  if (!shader)
+  if (!shader || !shader->ValidateContext(this))
     return ToV8(false);
   GLuint shader_id = shader ? shader->webgl_id() : 0;
   return ToV8<bool>(glIsShader(shader_id));
@@ -1648,7 +1800,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_isShader(const v8::Argumen
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_isTexture(const v8::Arguments& args) {
   bool ok = true;
   WebGLTexture* texture = NativeFromV8<WebGLTexture>(args[0], &ok); if (!ok) return U();
-  if (!texture)
+  if (!texture || !texture->ValidateContext(this))
     return ToV8(false);
   GLuint texture_id = texture ? texture->webgl_id() : 0;
   return ToV8<bool>(glIsTexture(texture_id));
@@ -1669,7 +1821,10 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_linkProgram(const v8::Argu
   if (!RequireObject(program)) return U();
   if (!ValidateObject(program)) return U();
   GLuint program_id = program->webgl_id();
+  double start = MonotonicTimeMs();
   glLinkProgram(program_id);
+  UpdateLinkStatus(program);
+  RecordProgramLink(MonotonicTimeMs() - start, program->link_status());
   return U();
 }
 
@@ -1715,6 +1870,50 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_polygonOffset(const v8::Ar
   return U();
 }
 
+// Not part of WebGL.
+// sequence<Object> precompilePrograms(sequence<Object> programs);
+// Each entry is { vs: DOMString, fs: DOMString, attribs: optional sequence<DOMString> },
+// attribs are bound to locations 0..n-1. Returns one entry per program:
+// { program, linked, translateTime, compileTime, linkTime, warmupTime } (ms).
+v8::Handle<v8::Value> WebGLRenderingContext::Callback_precompilePrograms(const v8::Arguments& args) {
+  if (!args[0]->IsArray())
+    return ThrowTypeError();
+  v8::Handle<v8::Array> array = v8::Handle<v8::Array>::Cast(args[0]);
+  std::vector<ProgramSource> sources(array->Length());
+  for (uint32_t i = 0; i < sources.size(); i++) {
+    v8::Local<v8::Value> entry = array->Get(i);
+    if (!entry->IsObject())
+      return ThrowTypeError();
+    v8::Local<v8::Object> object = entry->ToObject();
+    bool ok = true;
+    sources[i].vertex_source = FromV8<std::string>(object->Get(v8::String::New("vs")), &ok); if (!ok) return U();
+    sources[i].fragment_source = FromV8<std::string>(object->Get(v8::String::New("fs")), &ok); if (!ok) return U();
+    // attribs is optional
+    v8::Local<v8::Value> attributes = object->Get(v8::String::New("attribs"));
+    if (!attributes->IsUndefined()) {
+      sources[i].attributes = ArrayFromV8<std::string>(attributes, &ok);
+      if (!ok)
+        return ThrowTypeError();
+    }
+  }
+
+  std::vector<ProgramTimings> timings;
+  PrecompilePrograms(sources, &timings);
+
+  v8::Local<v8::Array> result = v8::Array::New(timings.size());
+  for (uint32_t i = 0; i < timings.size(); i++) {
+    v8::Local<v8::Object> entry = v8::Object::New();
+    entry->Set(v8::String::New("program"), timings[i].program);
+    entry->Set(v8::String::New("linked"), ToV8(timings[i].linked));
+    entry->Set(v8::String::New("translateTime"), ToV8(timings[i].translate_time));
+    entry->Set(v8::String::New("compileTime"), ToV8(timings[i].compile_time));
+    entry->Set(v8::String::New("linkTime"), ToV8(timings[i].link_time));
+    entry->Set(v8::String::New("warmupTime"), ToV8(timings[i].warmup_time));
+    result->Set(i, entry);
+  }
+  return result;
+}
+
 // void readPixels(GLint x, GLint y, GLsizei width, GLsizei height, 
 //                 GLenum format, GLenum type, ArrayBufferView pixels);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_readPixels(const v8::Arguments& args) {
@@ -1764,12 +1963,18 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_renderbufferStorage(const
     set_gl_error(GL_INVALID_ENUM);
     return U();
   }
+  if (width < 0 || height < 0) {
+    set_gl_error(GL_INVALID_VALUE);
+    return U();
+  }
+  size_t pixel_size = 2;
   //XXX some of these formats may not be supported on desktop GL - so we convert them (see GraphicsContext3DOpenGL.cpp:renderbufferStorage
   //XXX this means getRenderbufferParameter will return the wrong value - we should really stash the original value in the bound WebGLRenderbuffer
   //XXX http://www.khronos.org/webgl/public-mailing-list/archives/1010/msg00123.html
   switch (internalformat) {
     case GL_DEPTH_STENCIL:
       internalformat = GL_DEPTH24_STENCIL8;
+      pixel_size = 4;
       break;
     case GL_DEPTH_COMPONENT16:
       internalformat = GL_DEPTH_COMPONENT;
@@ -1782,13 +1987,23 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_renderbufferStorage(const
       internalformat = GL_RGB;
       break;
     case GL_STENCIL_INDEX8:
+      pixel_size = 1;
       break;
     default:
       set_gl_error(GL_INVALID_ENUM);
       return U();
   }
 
+  SaveGLError();
   glRenderbufferStorage(target, internalformat, width, height);
+  if (!GLCallSucceeded())
+    return U();
+
+  GLint renderbuffer_id = 0;
+  GetIntegerv(GL_RENDERBUFFER_BINDING, &renderbuffer_id);
+  WebGLRenderbuffer* renderbuffer = IdToRenderbuffer(renderbuffer_id);
+  if (renderbuffer)
+    SetMemorySize(&memory_info_.renderbuffer_bytes, renderbuffer, pixel_size * width * height);
   return U();
 }
 
@@ -1812,6 +2027,55 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_scissor(const v8::Argument
   return U();
 }
 
+// Not part of WebGL.
+// void setSpecializationConstants(WebGLProgram program, Object constants);
+// constants maps names of scalar float, int or bool uniforms to values that
+// are compiled into the shaders as constants, so branches and loops on them
+// can be folded. useProgram binds a variant built for the current values,
+// cached per program until it is relinked. Pass null to clear.
+v8::Handle<v8::Value> WebGLRenderingContext::Callback_setSpecializationConstants(const v8::Arguments& args) {
+  bool ok = true;
+  WebGLProgram* program = NativeFromV8<WebGLProgram>(args[0], &ok); if (!ok) return U();
+  if (!RequireObject(program)) return U();
+  if (!ValidateObject(program)) return U();
+  if (!program->has_variables()) {
+    Log(Logger::kWarn, "%s: %s", "setSpecializationConstants", "program not linked.");
+    set_gl_error(GL_INVALID_OPERATION);
+    return U();
+  }
+
+  SpecializationConstants constants;
+  if (!args[1]->IsUndefined() && !args[1]->IsNull()) {
+    if (!args[1]->IsObject())
+      return ThrowTypeError();
+    v8::Local<v8::Object> object = args[1]->ToObject();
+    v8::Local<v8::Array> names = object->GetPropertyNames();
+    for (uint32_t i = 0; i < names->Length(); i++) {
+      v8::Local<v8::Value> name_value = names->Get(i);
+      std::string name = FromV8<std::string>(name_value, &ok); if (!ok) return U();
+      double value = FromV8<double>(object->Get(name_value), &ok); if (!ok) return U();
+      const ShaderVariable* uniform = program->FindActiveUniform(name);
+      std::string literal;
+      // value - value is NaN for infinities and NaN
+      if (!uniform || uniform->size != 1 || value - value != 0
+          || !SpecializationLiteral(uniform->type, value, &literal)) {
+        Log(Logger::kWarn, "%s: %s", "setSpecializationConstants", "invalid scalar uniform or value.");
+        set_gl_error(GL_INVALID_VALUE);
+        return U();
+      }
+      constants[name] = literal;
+    }
+  }
+  program->specialization_constants().swap(constants);
+
+  // Switch variants now if the program is in use
+  GLint current_program_id = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &current_program_id);
+  if (IdToProgram(current_program_id) == program)
+    UseProgramVariant(program);
+  return U();
+}
+
 // void shaderSource(WebGLShader shader, DOMString source);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_shaderSource(const v8::Arguments& args) {
   bool ok = true;
@@ -1967,9 +2231,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_texSubImage2D(const v8::Ar
 // void uniform1f(WebGLUniformLocation location, GLfloat x);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform1f(const v8::Arguments& args) {
   bool ok = true;
-  WebGLUniformLocation* location = UniformLocationFromV8(args[0]);
+  GLint location_id = 0;
+  WebGLUniformLocation* location = UniformLocationFromV8(args[0], &location_id);
   if (!location) return U();
-  GLuint location_id = location->webgl_id();
 
   GLfloat x = FromV8<float>(args[1], &ok); if (!ok) return U();
   glUniform1f(location_id, x);
@@ -1986,9 +2250,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform1fv(const v8::Argum
 // void uniform1i(WebGLUniformLocation location, GLint x);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform1i(const v8::Arguments& args) {
   bool ok = true;
-  WebGLUniformLocation* location = UniformLocationFromV8(args[0]);
+  GLint location_id = 0;
+  WebGLUniformLocation* location = UniformLocationFromV8(args[0], &location_id);
   if (!location) return U();
-  GLuint location_id = location->webgl_id();
 
   GLint x = FromV8<int32_t>(args[1], &ok); if (!ok) return U();
   glUniform1i(location_id, x);
@@ -2005,9 +2269,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform1iv(const v8::Argum
 // void uniform2f(WebGLUniformLocation location, GLfloat x, GLfloat y);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform2f(const v8::Arguments& args) {
   bool ok = true;
-  WebGLUniformLocation* location = UniformLocationFromV8(args[0]);
+  GLint location_id = 0;
+  WebGLUniformLocation* location = UniformLocationFromV8(args[0], &location_id);
   if (!location) return U();
-  GLuint location_id = location->webgl_id();
 
   GLfloat x = FromV8<float>(args[1], &ok); if (!ok) return U();
   GLfloat y = FromV8<float>(args[2], &ok); if (!ok) return U();
@@ -2025,9 +2289,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform2fv(const v8::Argum
 // void uniform2i(WebGLUniformLocation location, GLint x, GLint y);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform2i(const v8::Arguments& args) {
   bool ok = true;
-  WebGLUniformLocation* location = UniformLocationFromV8(args[0]);
+  GLint location_id = 0;
+  WebGLUniformLocation* location = UniformLocationFromV8(args[0], &location_id);
   if (!location) return U();
-  GLuint location_id = location->webgl_id();
 
   GLint x = FromV8<int32_t>(args[1], &ok); if (!ok) return U();
   GLint y = FromV8<int32_t>(args[2], &ok); if (!ok) return U();
@@ -2045,9 +2309,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform2iv(const v8::Argum
 // void uniform3f(WebGLUniformLocation location, GLfloat x, GLfloat y, GLfloat z);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform3f(const v8::Arguments& args) {
   bool ok = true;
-  WebGLUniformLocation* location = UniformLocationFromV8(args[0]);
+  GLint location_id = 0;
+  WebGLUniformLocation* location = UniformLocationFromV8(args[0], &location_id);
   if (!location) return U();
-  GLuint location_id = location->webgl_id();
 
   GLfloat x = FromV8<float>(args[1], &ok); if (!ok) return U();
   GLfloat y = FromV8<float>(args[2], &ok); if (!ok) return U();
@@ -2066,9 +2330,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform3fv(const v8::Argum
 // void uniform3i(WebGLUniformLocation location, GLint x, GLint y, GLint z);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform3i(const v8::Arguments& args) {
   bool ok = true;
-  WebGLUniformLocation* location = UniformLocationFromV8(args[0]);
+  GLint location_id = 0;
+  WebGLUniformLocation* location = UniformLocationFromV8(args[0], &location_id);
   if (!location) return U();
-  GLuint location_id = location->webgl_id();
 
   GLint x = FromV8<int32_t>(args[1], &ok); if (!ok) return U();
   GLint y = FromV8<int32_t>(args[2], &ok); if (!ok) return U();
@@ -2087,9 +2351,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform3iv(const v8::Argum
 // void uniform4f(WebGLUniformLocation location, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform4f(const v8::Arguments& args) {
   bool ok = true;
-  WebGLUniformLocation* location = UniformLocationFromV8(args[0]);
+  GLint location_id = 0;
+  WebGLUniformLocation* location = UniformLocationFromV8(args[0], &location_id);
   if (!location) return U();
-  GLuint location_id = location->webgl_id();
 
   GLfloat x = FromV8<float>(args[1], &ok); if (!ok) return U();
   GLfloat y = FromV8<float>(args[2], &ok); if (!ok) return U();
@@ -2109,9 +2373,9 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform4fv(const v8::Argum
 // void uniform4i(WebGLUniformLocation location, GLint x, GLint y, GLint z, GLint w);
 v8::Handle<v8::Value> WebGLRenderingContext::Callback_uniform4i(const v8::Arguments& args) {
   bool ok = true;
-  WebGLUniformLocation* location = UniformLocationFromV8(args[0]);
+  GLint location_id = 0;
+  WebGLUniformLocation* location = UniformLocationFromV8(args[0], &location_id);
   if (!location) return U();
-  GLuint location_id = location->webgl_id();
 
   GLint x = FromV8<int32_t>(args[1], &ok); if (!ok) return U();
   GLint y = FromV8<int32_t>(args[2], &ok); if (!ok) return U();
@@ -2161,8 +2425,7 @@ v8::Handle<v8::Value> WebGLRenderingContext::Callback_useProgram(const v8::Argum
   WebGLProgram* program = NativeFromV8<WebGLProgram>(args[0], &ok); if (!ok) return U();
   if (!RequireObject(program)) return U();
   if (!ValidateObject(program)) return U();
-  GLuint program_id = program->webgl_id();
-  glUseProgram(program_id);
+  UseProgramVariant(program);
   return U();
 }
 
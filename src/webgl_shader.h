@@ -18,12 +18,20 @@ class WebGLShader : public WebGLObject<WebGLShader, GLuint> {
   std::string source() { return source_; }
   void set_source(const std::string& source) { source_ = source; }
 
+  // Source of the last compileShader, source() may have changed since.
+  const std::string& compiled_source() { return compiled_source_; }
+  void set_compiled_source(const std::string& source) { compiled_source_ = source; }
+
   std::string log() { return log_; }
   void set_log(const std::string& log) { log_ = log; }
 
   bool is_valid() { return is_valid_; }
   void set_is_valid(bool valid) { is_valid_ = valid; }
 
+  // Translator reflection data from the last compile.
+  ShaderVariableList& attributes() { return attributes_; }
+  ShaderVariableList& uniforms() { return uniforms_; }
+
  protected:
   WebGLShader(WebGLRenderingContext* context, GLuint shader_id)
       : WebGLObject<WebGLShader, GLuint>(context, shader_id)
@@ -34,7 +42,10 @@ class WebGLShader : public WebGLObject<WebGLShader, GLuint> {
  private:
   bool is_valid_;
   std::string source_;
+  std::string compiled_source_;
   std::string log_;
+  ShaderVariableList attributes_;
+  ShaderVariableList uniforms_;
 };
 
 }
@@ -7,18 +7,38 @@
 
 #include "webgl_object.h"
 #include "webgl_rendering_context.h"
+#include <map>
+#include <utility>
 
 namespace v8_webgl {
 
 class WebGLTexture : public WebGLObject<WebGLTexture, GLuint> {
  public:
   static const char* const ClassName() { return "WebGLTexture"; }
+  enum { kShareable = 1 };
+
+  // Bytes allocated by all levels of all faces.
+  size_t memory_size() { return memory_size_; }
+  void set_memory_size(size_t memory_size) { memory_size_ = memory_size; }
+
+  // Returns the size of all levels after replacing one.
+  size_t LevelMemorySize(GLenum target, GLint level, size_t size) {
+    size_t& level_size = level_sizes_[std::make_pair(target, level)];
+    size_t total = memory_size_ - level_size + size;
+    level_size = size;
+    return total;
+  }
 
  protected:
   WebGLTexture(WebGLRenderingContext* context, GLuint texture_id)
-      : WebGLObject<WebGLTexture, GLuint>(context, texture_id) {}
+      : WebGLObject<WebGLTexture, GLuint>(context, texture_id)
+      , memory_size_(0) {}
 
   friend class WebGLRenderingContext;
+
+ private:
+  size_t memory_size_;
+  std::map<std::pair<GLenum, GLint>, size_t> level_sizes_;
 };
 
 }
@@ -5,24 +5,31 @@
 #ifndef V8WEBGL_WEBGL_UNIFORM_LOCATION_H
 #define V8WEBGL_WEBGL_UNIFORM_LOCATION_H
 
+#include "object_pool.h"
 #include "webgl_object.h"
 #include "webgl_rendering_context.h"
+#include <string>
 
 namespace v8_webgl {
 
-class WebGLUniformLocation : public WebGLObject<WebGLUniformLocation, GLint> {
+class WebGLUniformLocation : public WebGLObject<WebGLUniformLocation, GLint>, public PooledObject<WebGLUniformLocation> {
  public:
   static const char* const ClassName() { return "WebGLUniformLocation"; }
+  // Locations own no GL object and are not tracked by the context, no dispose().
+  static void ConfigureConstructorTemplate(v8::Persistent<v8::FunctionTemplate> /* constructor */) {}
 
   bool ValidateProgram(GLuint program_id) { return program_id == program_id_; }
+  const std::string& name() { return name_; }
 
  protected:
-  WebGLUniformLocation(WebGLRenderingContext* context, GLuint program_id, GLint location_id)
-      : WebGLObject<WebGLUniformLocation, GLint>(context, location_id, true)
-      , program_id_(program_id) {}
+  WebGLUniformLocation(WebGLRenderingContext* context, GLuint program_id, GLint location_id, const std::string& name)
+      : WebGLObject<WebGLUniformLocation, GLint>(context, location_id, true, NewInstance())
+      , program_id_(program_id)
+      , name_(name) {}
 
  private:
   GLuint program_id_;
+  std::string name_;
 
   friend class WebGLRenderingContext;
 };
@@ -8,8 +8,16 @@ HEADERS += include/v8_webgl.h
 HEADERS += src/canvas.h
 HEADERS += src/console.h
 HEADERS += src/converters.h
+HEADERS += src/effect_chain.h
 HEADERS += src/gl.h
+HEADERS += src/object_pool.h
+HEADERS += src/object_table.h
+HEADERS += src/pool_allocator.h
+HEADERS += src/runtime.h
 HEADERS += src/shader_compiler.h
+HEADERS += src/shader_specialization.h
+HEADERS += src/share_group.h
+HEADERS += src/timer.h
 HEADERS += src/typed_array.h
 HEADERS += src/v8_binding.h
 HEADERS += src/v8_webgl_internal.h
@@ -78,11 +86,25 @@ ANGLE_HEADERS += $$ANGLE_DIR/src/compiler/VersionGLSL.h
 
 HEADERS += $$ANGLE_HEADERS
 
-SOURCES += example/gltest.cc
+# qmake CONFIG+=typed_array_bench builds the typed array benchmark
+# instead of gltest
+typed_array_bench {
+    SOURCES += example/typed_array_bench.cc
+    TARGET = typed_array_bench
+} else {
+    SOURCES += example/gltest.cc
+    TARGET = gltest
+}
 SOURCES += src/canvas.cc
 SOURCES += src/console.cc
 SOURCES += src/converters.cc
+SOURCES += src/effect_chain.cc
+SOURCES += src/frame_scheduler.cc
+SOURCES += src/pool_allocator.cc
+SOURCES += src/runtime.cc
 SOURCES += src/shader_compiler.cc
+SOURCES += src/shader_specialization.cc
+SOURCES += src/share_group.cc
 SOURCES += src/typed_array.cc
 SOURCES += src/v8_binding.cc
 SOURCES += src/v8_webgl.cc
@@ -160,9 +182,9 @@ INCLUDEPATH += src
 INCLUDEPATH += include
 
 LIBS += -L$$V8_DIR -lv8_g
+unix:!mac:LIBS += -lrt -lpthread
 
 QT += opengl
-TARGET = gltest
 
 CONFIG += console
 mac:CONFIG -= app_bundle